@@ -11,10 +11,25 @@
 #include <Windows.h>
 #include <vector>
 #include <thread>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 #include <chrono>
 #include <fstream>
 #include <string>
 #include <strstream>
+#include <cstdarg>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define _ENGINE_SSE
+#endif
 
 void swap (int& n1, int& n2) { int t = n1; n1 = n2; n2 = t; };
 
@@ -222,6 +237,16 @@ public:
 		}
 		return _normal;
 	}
+	/*the stored normal, or the one the vertices give if it was never computed, without touching the triangle*/
+	Vec4f faceNormal() const {
+		if (_normal.x != 0 || _normal.y != 0 || _normal.z != 0) return _normal;
+		Vec4f l1 = vert[1], l2 = vert[2];
+		l1 -= vert[0];
+		l2 -= vert[0];
+		Vec4f n = Vec4f::cross(l1, l2);
+		n.toUnit();
+		return n;
+	}
 	
 	Vec4f& calcNormal() {
 		Vec4f l2 = vert[2] - vert[0];
@@ -232,14 +257,333 @@ public:
 	}
 };
 
+/*ray for scene queries, only hits with 0 <= t <= tMax are reported, t is measured in units of dir*/
+struct Ray {
+	Vec4f origin;
+	Vec4f dir;
+	float tMax;
+
+	Ray() : tMax(FLT_MAX) {}
+	Ray(const Vec4f& origin, const Vec4f& dir, float tMax = FLT_MAX) : origin(origin), dir(dir), tMax(tMax) {}
+};
+
+/*closest hit of a ray query, tri is -1 if nothing was hit*/
+struct RayHit {
+	float t = FLT_MAX;
+	int tri = -1;
+	Vec4f point;
+};
+
+/*bounding volume hierarchy over the triangles of a mesh, in model space, built with binned SAH*/
+struct MeshBVH {
+	/*leaves have count > 0 and own the triangles [first, first + count), inner nodes have their left child
+	right after them and their right child at first*/
+	struct Node {
+		float bmin[3], bmax[3];
+		int first, count;
+	};
+
+	std::vector<Node> nodes;
+	/*triangles in leaf order, as vertex 0 and the two edges leaving it*/
+	std::vector<float> triData;
+	/*index into the mesh triangles for every triangle in leaf order*/
+	std::vector<int> triIndex;
+
+	bool empty() const { return nodes.empty(); }
+
+	void build(const std::vector<Tri>& tris) {
+		nodes.clear(); triData.clear(); triIndex.clear();
+		if (tris.empty()) return;
+
+		int n = (int)tris.size();
+		std::vector<float> centroid(n * 3), bmin(n * 3), bmax(n * 3);
+		triIndex.resize(n);
+		for (int i = 0; i < n; i++) {
+			triIndex[i] = i;
+			const Vec4f* v = tris[i].vert;
+			for (int k = 0; k < 3; k++) {
+				float a = (&v[0].x)[k], b = (&v[1].x)[k], c = (&v[2].x)[k];
+				bmin[i * 3 + k] = a < b ? (a < c ? a : c) : (b < c ? b : c);
+				bmax[i * 3 + k] = a > b ? (a > c ? a : c) : (b > c ? b : c);
+				centroid[i * 3 + k] = (a + b + c) / 3.f;
+			}
+		}
+
+		nodes.reserve(2 * n);
+		nodes.push_back(Node());
+		buildNode(0, 0, n, 0, centroid, bmin, bmax);
+
+		fillTriData(tris);
+	}
+
+	/*finds the closest hit along the ray, or with anyHit the first one found, which is enough for visibility*/
+	bool intersect(const Ray& ray, RayHit& hit, bool anyHit = false) const {
+		if (nodes.empty()) return false;
+
+		const float o[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+		const float d[3] = { ray.dir.x, ray.dir.y, ray.dir.z };
+		const float inv[3] = { 1.f / d[0], 1.f / d[1], 1.f / d[2] };
+		float tBest = ray.tMax;
+		int best = -1;
+
+		int stack[64];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const Node& node = nodes[stack[--top]];
+			if (boxDistance(node, o, inv, tBest) == FLT_MAX) continue;
+
+			if (node.count > 0) {
+				for (int i = node.first; i < node.first + node.count; i++) {
+					float t = triDistance(&triData[i * 9], o, d);
+					if (t < tBest) {
+						tBest = t;
+						best = i;
+						if (anyHit) break;
+					}
+				}
+				if (anyHit && best >= 0) break;
+				continue;
+			}
+
+			/*the nearer child is pushed last so it is visited first*/
+			int left = (int)(&node - &nodes[0]) + 1, right = node.first;
+			float tl = boxDistance(nodes[left], o, inv, tBest), tr = boxDistance(nodes[right], o, inv, tBest);
+			if (tl > tr) { int s = left; left = right; right = s; float f = tl; tl = tr; tr = f; }
+			if (tr != FLT_MAX) stack[top++] = right;
+			if (tl != FLT_MAX) stack[top++] = left;
+		}
+
+		if (best < 0) return false;
+		hit.t = tBest;
+		hit.tri = triIndex[best];
+		hit.point = { o[0] + d[0] * tBest, o[1] + d[1] * tBest, o[2] + d[2] * tBest };
+		return true;
+	}
+
+private:
+	void fillTriData(const std::vector<Tri>& tris) {
+		int n = (int)triIndex.size();
+		triData.resize(n * 9);
+		for (int i = 0; i < n; i++) {
+			const Vec4f* v = tris[triIndex[i]].vert;
+			float* d = &triData[i * 9];
+			d[0] = v[0].x; d[1] = v[0].y; d[2] = v[0].z;
+			d[3] = v[1].x - v[0].x; d[4] = v[1].y - v[0].y; d[5] = v[1].z - v[0].z;
+			d[6] = v[2].x - v[0].x; d[7] = v[2].y - v[0].y; d[8] = v[2].z - v[0].z;
+		}
+	}
+
+	void buildNode(int index, int first, int count, int depth, const std::vector<float>& centroid, const std::vector<float>& tmin, const std::vector<float>& tmax) {
+		const int BINS = 12;
+		const int LEAF_SIZE = 4;
+		const int MAX_DEPTH = 60;
+
+		float bmin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, bmax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		float cmin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, cmax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (int i = first; i < first + count; i++) {
+			int t = triIndex[i];
+			for (int k = 0; k < 3; k++) {
+				if (tmin[t * 3 + k] < bmin[k]) bmin[k] = tmin[t * 3 + k];
+				if (tmax[t * 3 + k] > bmax[k]) bmax[k] = tmax[t * 3 + k];
+				if (centroid[t * 3 + k] < cmin[k]) cmin[k] = centroid[t * 3 + k];
+				if (centroid[t * 3 + k] > cmax[k]) cmax[k] = centroid[t * 3 + k];
+			}
+		}
+		Node& node = nodes[index];
+		for (int k = 0; k < 3; k++) { node.bmin[k] = bmin[k]; node.bmax[k] = bmax[k]; }
+		node.first = first;
+		node.count = count;
+		if (count <= LEAF_SIZE || depth >= MAX_DEPTH) return;
+
+		/*bins the centroids along every axis and keeps the split with the lowest surface area cost*/
+		float bestCost = FLT_MAX;
+		int bestAxis = -1, bestBin = 0;
+		for (int axis = 0; axis < 3; axis++) {
+			float extent = cmax[axis] - cmin[axis];
+			if (extent <= 0) continue;
+
+			int binCount[BINS] = { 0 };
+			float binMin[BINS][3], binMax[BINS][3];
+			for (int b = 0; b < BINS; b++) {
+				for (int k = 0; k < 3; k++) { binMin[b][k] = FLT_MAX; binMax[b][k] = -FLT_MAX; }
+			}
+			for (int i = first; i < first + count; i++) {
+				int t = triIndex[i];
+				int b = binOf(centroid[t * 3 + axis], cmin[axis], extent, BINS);
+				binCount[b]++;
+				for (int k = 0; k < 3; k++) {
+					if (tmin[t * 3 + k] < binMin[b][k]) binMin[b][k] = tmin[t * 3 + k];
+					if (tmax[t * 3 + k] > binMax[b][k]) binMax[b][k] = tmax[t * 3 + k];
+				}
+			}
+
+			float leftArea[BINS - 1];
+			int leftCount[BINS - 1];
+			float accMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, accMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			int acc = 0;
+			for (int b = 0; b < BINS - 1; b++) {
+				acc += binCount[b];
+				grow(accMin, accMax, binMin[b], binMax[b]);
+				leftCount[b] = acc;
+				leftArea[b] = area(accMin, accMax);
+			}
+			for (int k = 0; k < 3; k++) { accMin[k] = FLT_MAX; accMax[k] = -FLT_MAX; }
+			acc = 0;
+			for (int b = BINS - 1; b > 0; b--) {
+				acc += binCount[b];
+				grow(accMin, accMax, binMin[b], binMax[b]);
+				if (acc == 0 || leftCount[b - 1] == 0) continue;
+				float cost = leftArea[b - 1] * leftCount[b - 1] + area(accMin, accMax) * acc;
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+
+		if (bestAxis < 0 || bestCost >= area(bmin, bmax) * count) return;
+
+		float extent = cmax[bestAxis] - cmin[bestAxis];
+		int* lo = &triIndex[first];
+		int* hi = &triIndex[first + count - 1];
+		while (lo <= hi) {
+			if (binOf(centroid[*lo * 3 + bestAxis], cmin[bestAxis], extent, BINS) < bestBin) lo++;
+			else { int s = *lo; *lo = *hi; *hi = s; hi--; }
+		}
+		int leftCount = (int)(lo - &triIndex[first]);
+
+		int left = (int)nodes.size();
+		nodes.push_back(Node());
+		buildNode(left, first, leftCount, depth + 1, centroid, tmin, tmax);
+		int right = (int)nodes.size();
+		nodes.push_back(Node());
+		buildNode(right, first + leftCount, count - leftCount, depth + 1, centroid, tmin, tmax);
+
+		nodes[index].first = right;
+		nodes[index].count = 0;
+	}
+
+	static int binOf(float c, float cmin, float extent, int bins) {
+		int b = (int)((c - cmin) / extent * bins);
+		return b < 0 ? 0 : (b >= bins ? bins - 1 : b);
+	}
+	static void grow(float* amin, float* amax, const float* bmin, const float* bmax) {
+		for (int k = 0; k < 3; k++) {
+			if (bmin[k] < amin[k]) amin[k] = bmin[k];
+			if (bmax[k] > amax[k]) amax[k] = bmax[k];
+		}
+	}
+	static float area(const float* bmin, const float* bmax) {
+		if (bmin[0] > bmax[0]) return 0;
+		float x = bmax[0] - bmin[0], y = bmax[1] - bmin[1], z = bmax[2] - bmin[2];
+		return x * y + y * z + z * x;
+	}
+
+	/*entry distance of the ray into the node box, FLT_MAX if it misses or enters past tMax*/
+	static float boxDistance(const Node& node, const float* o, const float* inv, float tMax) {
+		float t0 = 0, t1 = tMax;
+		for (int k = 0; k < 3; k++) {
+			float a = (node.bmin[k] - o[k]) * inv[k];
+			float b = (node.bmax[k] - o[k]) * inv[k];
+			if (a > b) { float s = a; a = b; b = s; }
+			if (a > t0) t0 = a;
+			if (b < t1) t1 = b;
+			if (t0 > t1) return FLT_MAX;
+		}
+		return t0;
+	}
+
+	/*moller-trumbore, returns FLT_MAX on a miss*/
+	static float triDistance(const float* tri, const float* o, const float* d) {
+		const float* e1 = tri + 3;
+		const float* e2 = tri + 6;
+		float p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+		float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+		if (det > -1e-8f && det < 1e-8f) return FLT_MAX;
+		float invDet = 1.f / det;
+
+		float s[3] = { o[0] - tri[0], o[1] - tri[1], o[2] - tri[2] };
+		float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * invDet;
+		if (u < 0 || u > 1) return FLT_MAX;
+
+		float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+		float v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * invDet;
+		if (v < 0 || u + v > 1) return FLT_MAX;
+
+		float t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * invDet;
+		return t >= 0 ? t : FLT_MAX;
+	}
+};
+
+/*bounds of the normals of a run of consecutive triangles, lets renderMesh reject the whole run when it all faces away*/
+struct NormalCone {
+	static const int SIZE = 64;
+
+	Vec4f center;
+	float radius = 0;
+	Vec4f axis;
+	/*sine of the widest angle between axis and a normal of the run, negative if the normals spread over a half space*/
+	float spread = -1;
+
+	void build(const Tri* tris, int count) {
+		Vec4f bmin = tris[0].vert[0], bmax = tris[0].vert[0];
+		axis = { 0,0,0 };
+		for (int i = 0; i < count; i++) {
+			for (int k = 0; k < 3; k++) {
+				const Vec4f& v = tris[i].vert[k];
+				if (v.x < bmin.x) bmin.x = v.x;
+				if (v.y < bmin.y) bmin.y = v.y;
+				if (v.z < bmin.z) bmin.z = v.z;
+				if (v.x > bmax.x) bmax.x = v.x;
+				if (v.y > bmax.y) bmax.y = v.y;
+				if (v.z > bmax.z) bmax.z = v.z;
+			}
+			axis += tris[i].faceNormal();
+		}
+		center = (bmin + bmax) * 0.5f;
+		axis.toUnit();
+
+		radius = 0;
+		float minDot = 1.f;
+		for (int i = 0; i < count; i++) {
+			for (int k = 0; k < 3; k++) {
+				Vec4f v = tris[i].vert[k];
+				Vec4f d = v - center;
+				float l = sqrtf(Vec4f::dotProd(d, d));
+				if (l > radius) radius = l;
+			}
+			float dp = Vec4f::dotProd(axis, tris[i].faceNormal());
+			if (dp < minDot) minDot = dp;
+		}
+		spread = minDot > 0 ? sqrtf(1.f - minDot * minDot) : -1.f;
+	}
+
+	/*true if every triangle of the run faces away from the given point, conservative*/
+	bool backFacing(const Vec4f& camera) const {
+		if (spread < 0) return false;
+		Vec4f d = center;
+		d -= camera;
+		float l = sqrtf(Vec4f::dotProd(d, d));
+		return -Vec4f::dotProd(axis, d) >= spread * (l + radius) + radius;
+	}
+};
+
 /*3D mesh of triangles*/
 struct Mesh {
 	Vec4f pos;
 	Vec4f rotation;
 	float scale;
+	/*only used when rendering to an rgb target*/
+	uint32_t color = 0xFFFFFF;
 
 private:
 	std::vector<Tri> _tris;
+	MeshBVH _bvh;
+	bool _bvhStale = false;
+	std::vector<NormalCone> _cones;
+	bool _conesStale = false;
 
 public:
 	Mesh() {}
@@ -248,16 +592,65 @@ public:
 		loadFromFile(filePath);
 	}
 
+	/*asking for writable triangles marks the bvh and cones stale until they are rebuilt, read through a const mesh otherwise*/
 	std::vector<Tri>& tris() {
+		_bvhStale = true;
+		_conesStale = true;
+		return _tris;
+	}
+	const std::vector<Tri>& tris() const {
 		return _tris;
 	}
 
+	/*hierarchy used by ray queries, loadFromFile builds it. it's never rebuilt behind the caller's back so the mesh can be
+	rendered and queried from several threads, ray queries on a stale one fail*/
+	const MeshBVH& bvh() const { return _bvh; }
+	bool bvhValid() const { return !_bvhStale; }
+	void rebuildBVH() {
+		_bvh.build(_tris);
+		_bvhStale = false;
+	}
+
+	/*normal cones of every NormalCone::SIZE consecutive triangles, same rules as bvh*/
+	const std::vector<NormalCone>& cones() const { return _cones; }
+	bool conesValid() const { return !_conesStale; }
+	void rebuildCones() {
+		_cones.resize((_tris.size() + NormalCone::SIZE - 1) / NormalCone::SIZE);
+		for (size_t c = 0; c < _cones.size(); c++) {
+			size_t first = c * NormalCone::SIZE;
+			size_t count = _tris.size() - first < NormalCone::SIZE ? _tris.size() - first : NormalCone::SIZE;
+			_cones[c].build(&_tris[first], (int)count);
+		}
+		_conesStale = false;
+	}
+
 	bool loadFromFile(const std::string& filePath) {
+		return loadFromFile(filePath, nullptr);
+	}
+
+	/*onBounds is called with the model space bounding box as soon as every vertex is read, before the faces are built*/
+	bool loadFromFile(const std::string& filePath, const std::function<void(const Vec4f&, const Vec4f&)>& onBounds) {
 		std::ifstream file(filePath);
 		if (!file.is_open()) return 0;
 
 		std::string line;
 		std::vector<Vec4f> verts;
+		bool boundsSent = false;
+		auto sendBounds = [&] {
+			boundsSent = true;
+			if (!onBounds || verts.empty()) return;
+			Vec4f bmin = verts[0], bmax = verts[0];
+			for (auto& v : verts) {
+				if (v.x < bmin.x) bmin.x = v.x;
+				if (v.y < bmin.y) bmin.y = v.y;
+				if (v.z < bmin.z) bmin.z = v.z;
+				if (v.x > bmax.x) bmax.x = v.x;
+				if (v.y > bmax.y) bmax.y = v.y;
+				if (v.z > bmax.z) bmax.z = v.z;
+			}
+			onBounds(bmin, bmax);
+		};
+
 		while (getline(file, line)) {
 			std::strstream s;
 			s << line;
@@ -269,15 +662,1352 @@ public:
 				verts.push_back(v);
 			}
 			if (line[0] == 'f') {
+				if (!boundsSent) sendBounds();
 				int f[3];
 				s >> junk >> f[0] >> f[1] >> f[2];
 				_tris.push_back({ verts[f[0] - 1], verts[f[1] - 1], verts[f[2] - 1] });
 			}
 		}
+		if (!boundsSent) sendBounds();
+		rebuildBVH();
+		rebuildCones();
+		return 1;
+	}
+};
+
+/*geometry that never moves, baked once into world space and split into chunks on a grid that are culled as a whole*/
+struct StaticBatch {
+	struct Chunk {
+		Vec4f bmin, bmax;
+		int firstVert, vertCount;
+		int firstTri, triCount;
+	};
+
+	/*vertices are shared by the triangles of their chunk, indices are relative to the chunk's first vertex*/
+	std::vector<Vec4f> verts;
+	std::vector<uint32_t> indices;
+	std::vector<Vec4f> normals;
+	std::vector<uint32_t> colors;
+	std::vector<Chunk> chunks;
+	int maxChunkVerts = 0;
+
+	/*world space triangles waiting for build*/
+	std::vector<Tri> pending;
+	std::vector<uint32_t> pendingColors;
+
+	/*bit pattern of a position, with -0 folded into 0 so it matches the way floats compare*/
+	struct PositionKey {
+		uint32_t bits[3];
+		PositionKey(const Vec4f& v) {
+			float c[3] = { v.x + 0.f, v.y + 0.f, v.z + 0.f };
+			memcpy(bits, c, sizeof(bits));
+		}
+		bool operator == (const PositionKey& o) const { return bits[0] == o.bits[0] && bits[1] == o.bits[1] && bits[2] == o.bits[2]; }
+		struct Hash {
+			size_t operator () (const PositionKey& k) const { return (size_t)(k.bits[0] * 73856093u ^ k.bits[1] * 19349663u ^ k.bits[2] * 83492791u); }
+		};
+	};
+
+	/*partitions the pending triangles by centroid into cubes of the given size and builds the buffers*/
+	void build(float chunkSize) {
+		verts.clear(); indices.clear(); normals.clear(); colors.clear(); chunks.clear();
+		maxChunkVerts = 0;
+		if (pending.empty() || chunkSize <= 0) return;
+
+		struct Entry { int64_t key; int tri; };
+		std::vector<Entry> order(pending.size());
+		for (size_t i = 0; i < pending.size(); i++) {
+			Vec4f c = (pending[i].vert[0] + pending[i].vert[1] + pending[i].vert[2]) / 3.f;
+			int64_t cx = (int64_t)floorf(c.x / chunkSize) & 0x1FFFFF;
+			int64_t cy = (int64_t)floorf(c.y / chunkSize) & 0x1FFFFF;
+			int64_t cz = (int64_t)floorf(c.z / chunkSize) & 0x1FFFFF;
+			order[i] = { cx << 42 | cy << 21 | cz, (int)i };
+		}
+		std::sort(order.begin(), order.end(), [](const Entry& a, const Entry& b) { return a.key < b.key || (a.key == b.key && a.tri < b.tri); });
+
+		std::unordered_map<PositionKey, uint32_t, PositionKey::Hash> seen;
+
+		for (size_t start = 0; start < order.size();) {
+			size_t end = start;
+			while (end < order.size() && order[end].key == order[start].key) end++;
+
+			Chunk chunk;
+			chunk.firstVert = (int)verts.size();
+			chunk.firstTri = (int)normals.size();
+			chunk.bmin = pending[order[start].tri].vert[0];
+			chunk.bmax = chunk.bmin;
+
+			/*identical positions inside a chunk become one vertex*/
+			seen.clear();
+			for (size_t i = start; i < end; i++) {
+				Tri& tri = pending[order[i].tri];
+				for (int k = 0; k < 3; k++) {
+					Vec4f& v = tri.vert[k];
+					auto found = seen.emplace(PositionKey(v), (uint32_t)seen.size());
+					uint32_t index = found.first->second;
+					if (found.second) {
+						verts.push_back(v);
+						if (v.x < chunk.bmin.x) chunk.bmin.x = v.x;
+						if (v.y < chunk.bmin.y) chunk.bmin.y = v.y;
+						if (v.z < chunk.bmin.z) chunk.bmin.z = v.z;
+						if (v.x > chunk.bmax.x) chunk.bmax.x = v.x;
+						if (v.y > chunk.bmax.y) chunk.bmax.y = v.y;
+						if (v.z > chunk.bmax.z) chunk.bmax.z = v.z;
+					}
+					indices.push_back(index);
+				}
+				normals.push_back(tri.faceNormal());
+				colors.push_back(pendingColors[order[i].tri]);
+			}
+
+			chunk.vertCount = (int)verts.size() - chunk.firstVert;
+			chunk.triCount = (int)normals.size() - chunk.firstTri;
+			if (chunk.vertCount > maxChunkVerts) maxChunkVerts = chunk.vertCount;
+			chunks.push_back(chunk);
+			start = end;
+		}
+	}
+
+	/*drops the pending triangles, the built buffers stay*/
+	void releasePending() {
+		pending.clear(); pending.shrink_to_fit();
+		pendingColors.clear(); pendingColors.shrink_to_fit();
+	}
+};
+
+/*counts the jobs of a batch that haven't finished yet, JobSystem::wait returns once it reaches zero*/
+struct JobGroup {
+	std::atomic<int> pending{ 0 };
+
+	JobGroup() {}
+	JobGroup(const JobGroup&) = delete;
+	JobGroup& operator = (const JobGroup&) = delete;
+
+	bool done() { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+/*tasks with dependencies, a task starts once every task it was added after has finished*/
+class TaskGraph {
+	friend class JobSystem;
+
+	struct Task {
+		std::function<void()> fn;
+		std::vector<int> next;
+		int deps = 0;
+	};
+	std::vector<Task> _tasks;
+
+public:
+	/*returns the id of the new task, after holds ids of tasks added before it*/
+	int add(std::function<void()> fn, std::initializer_list<int> after = {}) {
+		int id = (int)_tasks.size();
+		_tasks.push_back({ std::move(fn), {}, (int)after.size() });
+		for (int a : after) _tasks[a].next.push_back(id);
+		return id;
+	}
+
+	int size() { return (int)_tasks.size(); }
+	void clear() { _tasks.clear(); }
+};
+
+/*pool of worker threads, each with its own queue that other threads steal from when they run dry*/
+class JobSystem {
+	struct Job {
+		std::function<void()> fn;
+		JobGroup* group;
+	};
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	std::vector<std::unique_ptr<Queue>> _queues;
+	std::vector<std::thread> _workers;
+	std::atomic<int> _queued{ 0 };
+	std::atomic<unsigned int> _next{ 0 };
+	std::mutex _sleepMutex;
+	std::condition_variable _wake;
+	bool _stop = false;
+
+public:
+	JobSystem() {}
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator = (const JobSystem&) = delete;
+	~JobSystem() { stop(); }
+
+	/*starts the workers once, by default one less than the hardware threads since the caller helps while waiting*/
+	void start(int threads = -1) {
+		if (!_queues.empty()) return;
+		if (threads < 0) threads = (int)std::thread::hardware_concurrency() - 1;
+		if (threads < 1) threads = 1;
+
+		_stop = false;
+		for (int i = 0; i < threads; i++) _queues.emplace_back(new Queue());
+		for (int i = 0; i < threads; i++) _workers.emplace_back(&JobSystem::workerLoop, this, i);
+	}
+
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(_sleepMutex);
+			_stop = true;
+		}
+		_wake.notify_all();
+		for (auto& w : _workers) w.join();
+		_workers.clear();
+		_queues.clear();
+	}
+
+	int threads() { return (int)_workers.size(); }
+
+	/*queues the job as part of the group, it runs on the caller if the system isn't started*/
+	void run(JobGroup& group, std::function<void()> fn) {
+		group.pending.fetch_add(1, std::memory_order_relaxed);
+		if (_queues.empty()) {
+			fn();
+			group.pending.fetch_sub(1, std::memory_order_release);
+			return;
+		}
+
+		/*workers push to their own queue, anyone else spreads jobs over all of them*/
+		int index = current();
+		if (index < 0) index = _next.fetch_add(1, std::memory_order_relaxed) % _queues.size();
+		{
+			std::lock_guard<std::mutex> lock(_queues[index]->mutex);
+			_queues[index]->jobs.push_back({ std::move(fn), &group });
+		}
+		_queued.fetch_add(1, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lock(_sleepMutex);
+		}
+		_wake.notify_one();
+	}
+
+	/*runs queued jobs on the calling thread until the group is done*/
+	void wait(JobGroup& group) {
+		while (!group.done()) {
+			if (runOne(current())) continue;
+
+			/*nothing left to help with, sleeps until the group finishes or another job is queued*/
+			std::unique_lock<std::mutex> lock(_sleepMutex);
+			_wake.wait(lock, [&] { return _stop || group.done() || _queued.load(std::memory_order_acquire) > 0; });
+		}
+	}
+
+	/*calls fn with consecutive [from, to) ranges of at most grain indices covering [begin, end), returns when all are done*/
+	void parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& fn) {
+		if (grain < 1) grain = 1;
+		if (end - begin <= grain) {
+			if (begin < end) fn(begin, end);
+			return;
+		}
+
+		JobGroup group;
+		for (int i = begin; i < end; i += grain) {
+			int to = i + grain < end ? i + grain : end;
+			run(group, [&fn, i, to] { fn(i, to); });
+		}
+		wait(group);
+	}
+
+	/*runs every task of the graph once its dependencies are done, returns when all are done*/
+	void run(TaskGraph& graph) {
+		int n = graph.size();
+		if (n == 0) return;
+
+		std::vector<std::atomic<int>> remaining(n);
+		for (int i = 0; i < n; i++) remaining[i].store(graph._tasks[i].deps, std::memory_order_relaxed);
+
+		JobGroup group;
+		std::function<void(int)> launch = [&](int id) {
+			run(group, [&, id] {
+				graph._tasks[id].fn();
+				for (int next : graph._tasks[id].next) {
+					if (remaining[next].fetch_sub(1, std::memory_order_acq_rel) == 1) launch(next);
+				}
+			});
+		};
+		for (int i = 0; i < n; i++) {
+			if (graph._tasks[i].deps == 0) launch(i);
+		}
+		wait(group);
+	}
+
+private:
+	/*index of the calling thread's queue, -1 if it isn't one of the workers*/
+	int current() {
+		return workerSlot().owner == this ? workerSlot().index : -1;
+	}
+	struct WorkerSlot { JobSystem* owner; int index; };
+	static WorkerSlot& workerSlot() {
+		thread_local WorkerSlot slot = { nullptr, -1 };
+		return slot;
+	}
+
+	/*takes the newest job of the own queue, or the oldest of another one*/
+	bool runOne(int index) {
+		if (_queued.load(std::memory_order_acquire) == 0) return false;
+
+		Job job;
+		bool found = false;
+		int count = (int)_queues.size();
+		int start = index < 0 ? 0 : index;
+		for (int k = 0; k < count && !found; k++) {
+			Queue& q = *_queues[(start + k) % count];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			if (q.jobs.empty()) continue;
+			if (k == 0 && index >= 0) {
+				job = std::move(q.jobs.back());
+				q.jobs.pop_back();
+			}
+			else {
+				job = std::move(q.jobs.front());
+				q.jobs.pop_front();
+			}
+			found = true;
+		}
+		if (!found) return false;
+
+		_queued.fetch_sub(1, std::memory_order_relaxed);
+		job.fn();
+		if (job.group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			/*the group may not be touched past this point, its waiter is free to return and destroy it*/
+			{
+				std::lock_guard<std::mutex> lock(_sleepMutex);
+			}
+			_wake.notify_all();
+		}
+		return true;
+	}
+
+	void workerLoop(int index) {
+		workerSlot() = { this, index };
+		while (true) {
+			if (runOne(index)) continue;
+
+			std::unique_lock<std::mutex> lock(_sleepMutex);
+			_wake.wait(lock, [this] { return _stop || _queued.load(std::memory_order_acquire) > 0; });
+			if (_stop) return;
+		}
+	}
+};
+
+/*handle to a mesh being loaded in the background, can be polled every frame without blocking*/
+class MeshHandle {
+	friend class AssetLoader;
+
+	struct State {
+		std::atomic<int> stage{ 0 };
+		Vec4f boundsMin, boundsMax;
+		Mesh mesh;
+	};
+	std::shared_ptr<State> _state;
+
+public:
+	typedef enum : int { FAILED = -1, LOADING, BOUNDS, READY } Stage;
+
+	MeshHandle() {}
+
+	bool valid() { return _state != nullptr; }
+	Stage stage() { return _state ? (Stage)_state->stage.load(std::memory_order_acquire) : FAILED; }
+	bool failed() { return stage() == FAILED; }
+	/*true once the bounding box of the model is known, the geometry may still be loading*/
+	bool boundsReady() { return stage() >= BOUNDS; }
+	bool ready() { return stage() == READY; }
+
+	/*only meaningful once boundsReady returns true, in model space*/
+	Vec4f& boundsMin() { return _state->boundsMin; }
+	Vec4f& boundsMax() { return _state->boundsMax; }
+	/*only meaningful once ready returns true*/
+	Mesh& mesh() { return _state->mesh; }
+};
+
+/*loads assets on background threads, handles are returned immediately*/
+class AssetLoader {
+	std::vector<std::thread> _workers;
+	std::deque<std::function<void()>> _jobs;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	bool _stop = false;
+
+public:
+	AssetLoader() {}
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator = (const AssetLoader&) = delete;
+	~AssetLoader() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_wake.notify_all();
+		for (auto& w : _workers) w.join();
+	}
+
+	/*queues the given obj file, the mesh gets the given transform once loaded*/
+	MeshHandle loadMesh(const Vec4f& pos, const Vec4f& rotation, float scale, const std::string& filePath) {
+		MeshHandle handle;
+		handle._state = std::make_shared<MeshHandle::State>();
+		handle._state->mesh = Mesh(pos, rotation, scale);
+
+		std::shared_ptr<MeshHandle::State> state = handle._state;
+		push([state, filePath] {
+			auto onBounds = [&](const Vec4f& bmin, const Vec4f& bmax) {
+				state->boundsMin = bmin;
+				state->boundsMax = bmax;
+				state->stage.store(MeshHandle::BOUNDS, std::memory_order_release);
+			};
+			bool loaded = state->mesh.loadFromFile(filePath, onBounds);
+			state->stage.store(loaded ? MeshHandle::READY : MeshHandle::FAILED, std::memory_order_release);
+		});
+		return handle;
+	}
+
+private:
+	void push(std::function<void()> job) {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			/*threads are only started once something is actually loaded*/
+			if (_workers.empty()) {
+				unsigned int count = std::thread::hardware_concurrency() / 2;
+				if (count < 1) count = 1;
+				for (unsigned int i = 0; i < count; i++) {
+					_workers.emplace_back(&AssetLoader::workerLoop, this);
+				}
+			}
+			_jobs.push_back(std::move(job));
+		}
+		_wake.notify_one();
+	}
+
+	void workerLoop() {
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_wake.wait(lock, [this] { return _stop || !_jobs.empty(); });
+				if (_stop) return;
+				job = std::move(_jobs.front());
+				_jobs.pop_front();
+			}
+			job();
+		}
+	}
+};
+
+/*rectangle of the screen rendered from its own camera, yaw is rotation.y and pitch is rotation.x*/
+struct Viewport {
+	int x, y, w, h;
+	Vec4f camera;
+	Vec4f rotation;
+	float fovTan;
+
+	Viewport() : x(0), y(0), w(0), h(0), fovTan(1.f) {}
+	Viewport(int x, int y, int w, int h, float fov) : x(x), y(y), w(w), h(h), fovTan(1.f / tanf(fov / 2.f)) {}
+
+	void setFov(float fov) { fovTan = 1.f / tanf(fov / 2.f); }
+};
+
+/*particles stored as parallel arrays so the update can run four at a time, dead particles are removed every update*/
+class ParticleSystem {
+	int _count = 0;
+	int _capacity = 0;
+
+public:
+	std::vector<float> x, y;
+	std::vector<float> vx, vy;
+	std::vector<float> life;
+	std::vector<short> color;
+
+	ParticleSystem() {}
+	ParticleSystem(int capacity) { reserve(capacity); }
+
+	int size() const { return _count; }
+	int capacity() const { return _capacity; }
+	void clear() { _count = 0; }
+
+	/*the arrays are padded to a multiple of four so the update never needs a scalar tail*/
+	void reserve(int capacity) {
+		_capacity = capacity;
+		int padded = (capacity + 3) & ~3;
+		x.resize(padded); y.resize(padded);
+		vx.resize(padded); vy.resize(padded);
+		life.resize(padded); color.resize(padded);
+		if (_count > capacity) _count = capacity;
+	}
+
+	/*adds a particle, returns false if the system is full*/
+	bool emit(float px, float py, float pvx, float pvy, float plife, short pcolor) {
+		if (_count >= _capacity) return false;
+		x[_count] = px; y[_count] = py;
+		vx[_count] = pvx; vy[_count] = pvy;
+		life[_count] = plife; color[_count] = pcolor;
+		_count++;
+		return true;
+	}
+
+	/*integrates every particle with the given acceleration, split into jobs if a job system is given*/
+	void update(float dt, float ax = 0, float ay = 0, JobSystem* jobs = nullptr) {
+		if (_count == 0) return;
+
+		int blocks = (_count + 3) / 4;
+		if (!jobs) {
+			integrate(0, blocks * 4, dt, ax, ay);
+		}
+		else {
+			jobs->parallelFor(0, blocks, 4096, [&](int from, int to) {
+				integrate(from * 4, to * 4, dt, ax, ay);
+			});
+		}
+
+		/*keeps the survivors packed at the front, in order*/
+		int alive = 0;
+		for (int i = 0; i < _count; i++) {
+			if (life[i] <= 0) continue;
+			if (alive != i) {
+				x[alive] = x[i]; y[alive] = y[i];
+				vx[alive] = vx[i]; vy[alive] = vy[i];
+				life[alive] = life[i]; color[alive] = color[i];
+			}
+			alive++;
+		}
+		_count = alive;
+	}
+
+private:
+	/*updates [begin, end), both multiples of four*/
+	void integrate(int begin, int end, float dt, float ax, float ay) {
+		float* px = x.data(); float* py = y.data();
+		float* pvx = vx.data(); float* pvy = vy.data();
+		float* pl = life.data();
+#ifdef _ENGINE_SSE
+		__m128 vdt = _mm_set1_ps(dt);
+		__m128 vax = _mm_set1_ps(ax * dt), vay = _mm_set1_ps(ay * dt);
+		for (int i = begin; i < end; i += 4) {
+			__m128 nvx = _mm_add_ps(_mm_loadu_ps(pvx + i), vax);
+			__m128 nvy = _mm_add_ps(_mm_loadu_ps(pvy + i), vay);
+			_mm_storeu_ps(pvx + i, nvx);
+			_mm_storeu_ps(pvy + i, nvy);
+			_mm_storeu_ps(px + i, _mm_add_ps(_mm_loadu_ps(px + i), _mm_mul_ps(nvx, vdt)));
+			_mm_storeu_ps(py + i, _mm_add_ps(_mm_loadu_ps(py + i), _mm_mul_ps(nvy, vdt)));
+			_mm_storeu_ps(pl + i, _mm_sub_ps(_mm_loadu_ps(pl + i), vdt));
+		}
+#else
+		for (int i = begin; i < end; i++) {
+			pvx[i] += ax * dt; pvy[i] += ay * dt;
+			px[i] += pvx[i] * dt; py[i] += pvy[i] * dt;
+			pl[i] -= dt;
+		}
+#endif
+	}
+};
+
+/*frames are stored as runs of unchanged cells followed by runs of cells xored against the previous frame, keyframes
+are xored against an empty frame so they decode on their own. the file ends with an index of every frame*/
+namespace FrameStream {
+	const uint32_t MAGIC = 0x43455246;
+	const uint32_t INDEX_MAGIC = 0x58444E49;
+
+	struct Header { uint32_t magic, version, width, height, keyInterval; };
+	struct Record { uint32_t keyframe, size; double time; };
+	struct IndexEntry { uint64_t offset; double time; uint32_t keyframe, pad; };
+	struct Footer { uint64_t indexOffset; uint32_t frameCount, magic; };
+
+	/*appends the difference between cur and prev as [skip, count, count xored cells] runs, prev may be null*/
+	inline void encode(const uint32_t* cur, const uint32_t* prev, int n, std::vector<uint8_t>& out) {
+		auto put16 = [&](uint16_t v) { out.push_back((uint8_t)v); out.push_back((uint8_t)(v >> 8)); };
+		int i = 0;
+		while (i < n) {
+			uint16_t skip = 0;
+			while (i < n && skip < 0xFFFF && cur[i] == (prev ? prev[i] : 0)) { i++; skip++; }
+			int start = i;
+			uint16_t count = 0;
+			while (i < n && count < 0xFFFF && cur[i] != (prev ? prev[i] : 0)) { i++; count++; }
+
+			put16(skip);
+			put16(count);
+			size_t at = out.size();
+			out.resize(at + count * 4);
+			for (int k = 0; k < count; k++) {
+				uint32_t v = cur[start + k] ^ (prev ? prev[start + k] : 0);
+				memcpy(out.data() + at + k * 4, &v, 4);
+			}
+		}
+	}
+
+	/*applies an encoded frame to the given buffer, which must hold the previous frame or zeros for a keyframe*/
+	inline void decode(const uint8_t* in, uint32_t size, uint32_t* frame, int n) {
+		const uint8_t* end = in + size;
+		int i = 0;
+		while (in + 4 <= end) {
+			uint16_t skip = in[0] | (in[1] << 8);
+			uint16_t count = in[2] | (in[3] << 8);
+			in += 4;
+			i += skip;
+			if (i + count > n || in + count * 4 > end) return;
+			for (int k = 0; k < count; k++) {
+				uint32_t v;
+				memcpy(&v, in + k * 4, 4);
+				frame[i + k] ^= v;
+			}
+			in += count * 4;
+			i += count;
+		}
+	}
+}
+
+/*records frames to a file, push only copies the frame, encoding and writing happen on a background thread*/
+class FrameRecorder {
+	std::ofstream _file;
+	int _width = 0, _height = 0, _keyInterval = 0;
+
+	std::thread _writer;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	bool _stop = false;
+
+	struct Frame { std::vector<uint32_t> cells; double time; };
+	std::deque<Frame> _queue;
+	std::vector<std::vector<uint32_t>> _free;
+	int _inFlight = 0;
+	int _dropped = 0;
+
+	std::vector<FrameStream::IndexEntry> _index;
+
+public:
+	/*frames queued beyond this are dropped rather than stalling the caller*/
+	static const int MAX_QUEUED = 8;
+
+	FrameRecorder() {}
+	FrameRecorder(const FrameRecorder&) = delete;
+	FrameRecorder& operator = (const FrameRecorder&) = delete;
+	~FrameRecorder() { close(); }
+
+	/*creates the file and starts the writer thread, every keyInterval-th frame is a keyframe*/
+	bool open(const std::string& filePath, int width, int height, int keyInterval = 60) {
+		if (_file.is_open() || width <= 0 || height <= 0 || keyInterval <= 0) return 0;
+		_file.open(filePath, std::ios::binary | std::ios::trunc);
+		if (!_file.is_open()) return 0;
+
+		_width = width; _height = height; _keyInterval = keyInterval;
+		FrameStream::Header header = { FrameStream::MAGIC, 1, (uint32_t)width, (uint32_t)height, (uint32_t)keyInterval };
+		_file.write((const char*)&header, sizeof(header));
+
+		_stop = false;
+		_dropped = 0;
+		_index.clear();
+		/*buffers are allocated up front so push never touches fresh memory*/
+		_free.assign(MAX_QUEUED, std::vector<uint32_t>(width * height));
+		_writer = std::thread(&FrameRecorder::writerLoop, this);
+		return 1;
+	}
+
+	bool recording() { return _file.is_open(); }
+	int dropped() { return _dropped; }
+
+	/*copies the frame for the writer, returns false if it had to be dropped*/
+	bool push(const CHAR_INFO* frame, double time) {
+		if (!_file.is_open()) return false;
+		static_assert(sizeof(CHAR_INFO) == sizeof(uint32_t), "cells are encoded as 32 bit words");
+
+		std::vector<uint32_t> cells;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_inFlight >= MAX_QUEUED) {
+				_dropped++;
+				return false;
+			}
+			_inFlight++;
+			if (!_free.empty()) {
+				cells = std::move(_free.back());
+				_free.pop_back();
+			}
+		}
+		cells.resize(_width * _height);
+		memcpy(cells.data(), frame, cells.size() * sizeof(uint32_t));
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_queue.push_back({ std::move(cells), time });
+		}
+		_wake.notify_one();
+		return true;
+	}
+
+	/*writes every queued frame and the index, then closes the file*/
+	void close() {
+		if (!_file.is_open()) return;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_wake.notify_one();
+		_writer.join();
+
+		FrameStream::Footer footer = { (uint64_t)_file.tellp(), (uint32_t)_index.size(), FrameStream::INDEX_MAGIC };
+		_file.write((const char*)_index.data(), _index.size() * sizeof(FrameStream::IndexEntry));
+		_file.write((const char*)&footer, sizeof(footer));
+		_file.close();
+	}
+
+private:
+	void writerLoop() {
+		std::vector<uint32_t> prev(_width * _height);
+		std::vector<uint8_t> encoded;
+
+		while (true) {
+			Frame frame;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_wake.wait(lock, [this] { return _stop || !_queue.empty(); });
+				if (_queue.empty()) return;
+				frame = std::move(_queue.front());
+				_queue.pop_front();
+			}
+
+			bool key = _index.size() % _keyInterval == 0;
+			encoded.clear();
+			FrameStream::encode(frame.cells.data(), key ? nullptr : prev.data(), (int)frame.cells.size(), encoded);
+
+			FrameStream::Record record = { key, (uint32_t)encoded.size(), frame.time };
+			_index.push_back({ (uint64_t)_file.tellp(), frame.time, key, 0 });
+			_file.write((const char*)&record, sizeof(record));
+			_file.write((const char*)encoded.data(), encoded.size());
+
+			prev.swap(frame.cells);
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_free.push_back(std::move(frame.cells));
+				_inFlight--;
+			}
+		}
+	}
+};
+
+/*plays back a file written by FrameRecorder through a read only mapping of it*/
+class FrameReplayer {
+	HANDLE _fileHandle = INVALID_HANDLE_VALUE;
+	HANDLE _mapping = NULL;
+	const uint8_t* _data = nullptr;
+	uint64_t _size = 0;
+
+	FrameStream::Header _header;
+	std::vector<FrameStream::IndexEntry> _index;
+	std::vector<uint32_t> _frame;
+	int _current = -1;
+
+public:
+	FrameReplayer() {}
+	FrameReplayer(const FrameReplayer&) = delete;
+	FrameReplayer& operator = (const FrameReplayer&) = delete;
+	~FrameReplayer() { close(); }
+
+	/*maps the file, recordings that were never closed are indexed by walking their records*/
+	bool open(const std::string& filePath) {
+		close();
+		_fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (_fileHandle == INVALID_HANDLE_VALUE) return 0;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(_fileHandle, &size) || (uint64_t)size.QuadPart < sizeof(FrameStream::Header)) { close(); return 0; }
+		_size = size.QuadPart;
+
+		_mapping = CreateFileMappingA(_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (_mapping == NULL) { close(); return 0; }
+		_data = (const uint8_t*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+		if (_data == nullptr) { close(); return 0; }
+
+		memcpy(&_header, _data, sizeof(_header));
+		if (_header.magic != FrameStream::MAGIC) { close(); return 0; }
+
+		if (!readIndex()) scanIndex();
+		_frame.assign(_header.width * _header.height, 0);
+		_current = -1;
+		return 1;
+	}
+
+	void close() {
+		if (_data) UnmapViewOfFile(_data);
+		if (_mapping) CloseHandle(_mapping);
+		if (_fileHandle != INVALID_HANDLE_VALUE) CloseHandle(_fileHandle);
+		_data = nullptr; _mapping = NULL; _fileHandle = INVALID_HANDLE_VALUE;
+		_index.clear();
+		_current = -1;
+	}
+
+	int width() { return _header.width; }
+	int height() { return _header.height; }
+	int frameCount() { return (int)_index.size(); }
+	double duration() { return _index.empty() ? 0 : _index.back().time - _index.front().time; }
+
+	/*the last decoded frame, width() * height() cells*/
+	const CHAR_INFO* frame() { return (const CHAR_INFO*)_frame.data(); }
+	int current() { return _current; }
+
+	/*decodes the given frame, moving forward from the current one when no keyframe is closer*/
+	bool seek(int n) {
+		if (n < 0 || n >= (int)_index.size()) return 0;
+		if (n == _current) return 1;
+
+		int key = n;
+		while (key > 0 && !_index[key].keyframe) key--;
+		int from = key;
+		if (_current >= key && _current < n) from = _current + 1;
+		else std::fill(_frame.begin(), _frame.end(), 0);
+
+		for (int i = from; i <= n; i++) {
+			FrameStream::Record record;
+			memcpy(&record, _data + _index[i].offset, sizeof(record));
+			FrameStream::decode(_data + _index[i].offset + sizeof(record), record.size, _frame.data(), (int)_frame.size());
+		}
+		_current = n;
+		return 1;
+	}
+
+	/*seeks to the last frame recorded at or before the given number of seconds since the first one*/
+	bool seekTime(double seconds) {
+		if (_index.empty()) return 0;
+		double t = _index.front().time + seconds;
+		int lo = 0, hi = (int)_index.size() - 1;
+		while (lo < hi) {
+			int mid = (lo + hi + 1) / 2;
+			if (_index[mid].time <= t) lo = mid;
+			else hi = mid - 1;
+		}
+		return seek(lo);
+	}
+
+private:
+	bool readIndex() {
+		if (_size < sizeof(FrameStream::Header) + sizeof(FrameStream::Footer)) return 0;
+		FrameStream::Footer footer;
+		memcpy(&footer, _data + _size - sizeof(footer), sizeof(footer));
+		if (footer.magic != FrameStream::INDEX_MAGIC) return 0;
+		if (footer.indexOffset < sizeof(FrameStream::Header) + sizeof(FrameStream::Record) || footer.indexOffset > _size) return 0;
+		if (footer.indexOffset + (uint64_t)footer.frameCount * sizeof(FrameStream::IndexEntry) + sizeof(footer) != _size) return 0;
+
+		_index.resize(footer.frameCount);
+		memcpy(_index.data(), _data + footer.indexOffset, footer.frameCount * sizeof(FrameStream::IndexEntry));
+
+		/*every record has to lie before the index, otherwise the file is rescanned*/
+		for (auto& entry : _index) {
+			if (entry.offset < sizeof(FrameStream::Header) || entry.offset > footer.indexOffset - sizeof(FrameStream::Record)) { _index.clear(); return 0; }
+			FrameStream::Record record;
+			memcpy(&record, _data + entry.offset, sizeof(record));
+			if (entry.offset + sizeof(record) + record.size > footer.indexOffset) { _index.clear(); return 0; }
+		}
+		return 1;
+	}
+
+	void scanIndex() {
+		uint64_t at = sizeof(FrameStream::Header);
+		while (at + sizeof(FrameStream::Record) <= _size) {
+			FrameStream::Record record;
+			memcpy(&record, _data + at, sizeof(record));
+			if (at + sizeof(record) + record.size > _size) break;
+			_index.push_back({ at, record.time, record.keyframe, 0 });
+			at += sizeof(record) + record.size;
+		}
+	}
+};
+
+/*frames shared with viewer processes through a named mapping, laid out as a header followed by a ring of slots. frame n
+goes to slot (n - 1) % slots, whose sequence is 2n - 1 while it's being written and 2n once it's complete*/
+namespace FrameBroadcast {
+	const uint32_t MAGIC = 0x54534342;
+
+	struct Header {
+		uint32_t magic, width, height, slots, fontWidth, fontHeight;
+		/*number of the newest complete frame, 0 before the first one*/
+		std::atomic<uint64_t> latest;
+		std::atomic<uint32_t> closed;
+		uint32_t pad;
+	};
+	/*the frame's cells follow the slot*/
+	struct Slot {
+		std::atomic<uint64_t> seq;
+		double time;
+	};
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "the ring is shared between processes");
+
+	inline size_t slotStride(uint32_t width, uint32_t height) {
+		return (sizeof(Slot) + width * height * sizeof(CHAR_INFO) + 63) & ~(size_t)63;
+	}
+	inline size_t mappingSize(uint32_t width, uint32_t height, uint32_t slots) {
+		return ((sizeof(Header) + 63) & ~(size_t)63) + slotStride(width, height) * slots;
+	}
+	inline Slot* slot(void* base, const Header* header, uint64_t frame) {
+		return (Slot*)((uint8_t*)base + ((sizeof(Header) + 63) & ~(size_t)63) + slotStride(header->width, header->height) * ((frame - 1) % header->slots));
+	}
+}
+
+/*publishes frames into a named mapping, publishing is one copy into the ring and never waits on viewers*/
+class FramePublisher {
+	HANDLE _mapping = NULL;
+	void* _data = nullptr;
+	FrameBroadcast::Header* _header = nullptr;
+	uint64_t _frame = 0;
+
+public:
+	FramePublisher() {}
+	FramePublisher(const FramePublisher&) = delete;
+	FramePublisher& operator = (const FramePublisher&) = delete;
+	~FramePublisher() { close(); }
+
+	/*creates the mapping under the given name, fails if someone already publishes under it*/
+	bool open(const std::string& name, int width, int height, int fontWidth, int fontHeight, int slots = 8) {
+		if (_data || width <= 0 || height <= 0 || slots < 2) return 0;
+		uint64_t size = FrameBroadcast::mappingSize(width, height, slots);
+
+		_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, name.c_str());
+		if (_mapping == NULL) return 0;
+		if (GetLastError() == ERROR_ALREADY_EXISTS) { close(); return 0; }
+		_data = MapViewOfFile(_mapping, FILE_MAP_WRITE, 0, 0, (size_t)size);
+		if (_data == nullptr) { close(); return 0; }
+
+		/*fresh mappings are zeroed, so every slot starts with sequence 0*/
+		_header = (FrameBroadcast::Header*)_data;
+		_header->width = width; _header->height = height; _header->slots = slots;
+		_header->fontWidth = fontWidth; _header->fontHeight = fontHeight;
+		_header->latest.store(0, std::memory_order_relaxed);
+		_header->closed.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		_header->magic = FrameBroadcast::MAGIC;
+		_frame = 0;
+		return 1;
+	}
+
+	/*tells the viewers no more frames will come and drops the mapping*/
+	void close() {
+		if (_header) _header->closed.store(1, std::memory_order_release);
+		if (_data) UnmapViewOfFile(_data);
+		if (_mapping) CloseHandle(_mapping);
+		_data = nullptr; _header = nullptr; _mapping = NULL;
+	}
+
+	bool publishing() { return _data != nullptr; }
+	uint64_t frames() { return _frame; }
+
+	void publish(const CHAR_INFO* frame, double time) {
+		if (!_data) return;
+		uint64_t n = ++_frame;
+		FrameBroadcast::Slot* slot = FrameBroadcast::slot(_data, _header, n);
+
+		slot->seq.store(2 * n - 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot->time = time;
+		memcpy((CHAR_INFO*)(slot + 1), frame, _header->width * _header->height * sizeof(CHAR_INFO));
+		slot->seq.store(2 * n, std::memory_order_release);
+		_header->latest.store(n, std::memory_order_release);
+	}
+};
+
+/*reads the newest frame of a FramePublisher straight out of the mapping, frames published while the previous one was
+being presented are skipped*/
+class FrameViewer {
+	HANDLE _mapping = NULL;
+	void* _data = nullptr;
+	const FrameBroadcast::Header* _header = nullptr;
+	uint64_t _shown = 0;
+	uint64_t _pending = 0;
+	uint64_t _dropped = 0;
+
+public:
+	FrameViewer() {}
+	FrameViewer(const FrameViewer&) = delete;
+	FrameViewer& operator = (const FrameViewer&) = delete;
+	~FrameViewer() { close(); }
+
+	bool open(const std::string& name) {
+		close();
+		_mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+		if (_mapping == NULL) return 0;
+		_data = MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+		if (_data == nullptr) { close(); return 0; }
+
+		_header = (const FrameBroadcast::Header*)_data;
+		if (_header->magic != FrameBroadcast::MAGIC) { close(); return 0; }
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return 1;
+	}
+
+	void close() {
+		if (_data) UnmapViewOfFile(_data);
+		if (_mapping) CloseHandle(_mapping);
+		_data = nullptr; _header = nullptr; _mapping = NULL;
+		_shown = _pending = _dropped = 0;
+	}
+
+	int width() { return _header ? _header->width : 0; }
+	int height() { return _header ? _header->height : 0; }
+	int fontWidth() { return _header ? _header->fontWidth : 0; }
+	int fontHeight() { return _header ? _header->fontHeight : 0; }
+	/*true once the publisher stopped*/
+	bool closed() { return !_header || _header->closed.load(std::memory_order_acquire); }
+	/*frames that were never shown because newer ones had arrived*/
+	uint64_t dropped() { return _dropped; }
+
+	/*the cells of the newest frame if one arrived since the last released, they live in the mapping so call release
+	once done with them*/
+	const CHAR_INFO* acquire() {
+		if (!_header) return nullptr;
+		uint64_t n = _header->latest.load(std::memory_order_acquire);
+		if (n == 0 || n == _shown) return nullptr;
+
+		const FrameBroadcast::Slot* slot = FrameBroadcast::slot(_data, _header, n);
+		if (slot->seq.load(std::memory_order_acquire) != 2 * n) return nullptr;
+		_pending = n;
+		return (const CHAR_INFO*)(slot + 1);
+	}
+
+	/*returns false if the publisher reused the slot while the frame was in use, it may have been torn*/
+	bool release() {
+		if (!_header || _pending == 0) return 0;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const FrameBroadcast::Slot* slot = FrameBroadcast::slot(_data, _header, _pending);
+		uint64_t n = _pending;
+		_pending = 0;
+		if (slot->seq.load(std::memory_order_relaxed) != 2 * n) return 0;
+
+		if (_shown) _dropped += n - _shown - 1;
+		_shown = n;
 		return 1;
 	}
 };
 
+/*grid of tile ids stored in square chunks, every chunk keeps its tiles already turned into cells and only rebuilds
+them after an edit*/
+class TileMap {
+public:
+	static const int CHUNK = 16;
+
+private:
+	struct Chunk {
+		uint16_t tiles[CHUNK * CHUNK] = { 0 };
+		CHAR_INFO image[CHUNK * CHUNK];
+		bool dirty = true;
+		uint32_t version = 1;
+	};
+
+	int _width = 0, _height = 0;
+	int _chunksX = 0, _chunksY = 0;
+	std::vector<Chunk> _chunks;
+	std::vector<CHAR_INFO> _tileset;
+	uint32_t _tilesetVersion = 1;
+
+public:
+	TileMap() {}
+	TileMap(int width, int height) { resize(width, height); }
+
+	/*size in tiles, clears the map*/
+	void resize(int width, int height) {
+		_width = width; _height = height;
+		_chunksX = (width + CHUNK - 1) / CHUNK;
+		_chunksY = (height + CHUNK - 1) / CHUNK;
+		_chunks.assign(_chunksX * _chunksY, Chunk());
+		_tilesetVersion++;
+	}
+
+	int width() const { return _width; }
+	int height() const { return _height; }
+	int chunksX() const { return _chunksX; }
+	int chunksY() const { return _chunksY; }
+	uint32_t tilesetVersion() const { return _tilesetVersion; }
+
+	/*the cell drawn for every tile id, ids without one are drawn empty*/
+	void setTileset(const std::vector<CHAR_INFO>& tileset) {
+		_tileset = tileset;
+		for (auto& c : _chunks) c.dirty = true;
+		_tilesetVersion++;
+	}
+	void setTileDef(uint16_t id, const CHAR_INFO& cell) {
+		if (id >= _tileset.size()) {
+			CHAR_INFO empty;
+			empty.Char.UnicodeChar = ' ';
+			empty.Attributes = 0;
+			_tileset.resize(id + 1, empty);
+		}
+		_tileset[id] = cell;
+		for (auto& c : _chunks) c.dirty = true;
+		_tilesetVersion++;
+	}
+
+	uint16_t tile(int x, int y) const {
+		if (x < 0 || y < 0 || x >= _width || y >= _height) return 0;
+		return _chunks[(y / CHUNK) * _chunksX + x / CHUNK].tiles[(y % CHUNK) * CHUNK + x % CHUNK];
+	}
+
+	void setTile(int x, int y, uint16_t id) {
+		if (x < 0 || y < 0 || x >= _width || y >= _height) return;
+		Chunk& c = _chunks[(y / CHUNK) * _chunksX + x / CHUNK];
+		uint16_t& t = c.tiles[(y % CHUNK) * CHUNK + x % CHUNK];
+		if (t == id) return;
+		t = id;
+		c.dirty = true;
+		c.version++;
+	}
+
+	/*bumped on every edit of the chunk*/
+	uint32_t chunkVersion(int cx, int cy) const { return _chunks[cy * _chunksX + cx].version; }
+
+	/*cells of the chunk, CHUNK x CHUNK row by row, rebuilt here if it was edited*/
+	const CHAR_INFO* chunkImage(int cx, int cy) {
+		Chunk& c = _chunks[cy * _chunksX + cx];
+		if (c.dirty) {
+			for (int i = 0; i < CHUNK * CHUNK; i++) {
+				int x = cx * CHUNK + i % CHUNK, y = cy * CHUNK + i / CHUNK;
+				uint16_t id = c.tiles[i];
+				if (x < _width && y < _height && id < _tileset.size()) {
+					c.image[i] = _tileset[id];
+				}
+				else {
+					c.image[i].Char.UnicodeChar = ' ';
+					c.image[i].Attributes = 0;
+				}
+			}
+			c.dirty = false;
+		}
+		return c.image;
+	}
+};
+
+/*what a TileMap looked like the last time it was drawn to a screen rectangle, lets the next draw only redo the
+difference*/
+struct TileMapView {
+	int x = 0, y = 0, w = 0, h = 0;
+	int scrollX = 0, scrollY = 0;
+
+	std::vector<CHAR_INFO> cells;
+	std::vector<uint32_t> versions;
+	uint32_t tilesetVersion = 0;
+	bool valid = false;
+
+	TileMapView() {}
+	TileMapView(int x, int y, int w, int h) : x(x), y(y), w(w), h(h) {}
+
+	void invalidate() { valid = false; }
+};
+
+/*broadphase for 2D boxes in screen cell units. space is cut into square cells hashed into a fixed bucket table and
+every entity sits in the bucket of the cell holding its center, linked through flat arrays. boxes with a half extent
+over the cell size go to a list of their own that every query tests directly. queries aren't thread safe*/
+class SpatialHash {
+	float _cellSize, _invCell;
+	int _mask;
+	std::vector<int> _heads;
+	std::vector<uint32_t> _visited;
+	uint32_t _stamp = 0;
+
+	std::vector<float> _x, _y, _hw, _hh;
+	std::vector<int> _next, _prev, _bucket;
+	std::vector<int> _free;
+	int _count = 0;
+	/*head of the list of large boxes, kept past the hashed buckets*/
+	int _large;
+
+public:
+	/*buckets is rounded up to a power of two*/
+	SpatialHash(float cellSize = 8.f, int buckets = 4096) : _cellSize(cellSize), _invCell(1.f / cellSize) {
+		int size = 1;
+		while (size < buckets) size <<= 1;
+		_mask = size - 1;
+		_large = size;
+		_heads.assign(size + 1, -1);
+		_visited.assign(size, 0);
+	}
+
+	int size() { return _count; }
+	bool valid(int id) { return id >= 0 && id < (int)_bucket.size() && _bucket[id] >= 0; }
+
+	/*adds a box with the given center and half extents, returns its id*/
+	int insert(float x, float y, float halfW, float halfH) {
+		int id;
+		if (!_free.empty()) {
+			id = _free.back();
+			_free.pop_back();
+		}
+		else {
+			id = (int)_x.size();
+			_x.push_back(0); _y.push_back(0); _hw.push_back(0); _hh.push_back(0);
+			_next.push_back(-1); _prev.push_back(-1); _bucket.push_back(-1);
+		}
+		_x[id] = x; _y[id] = y;
+		_hw[id] = halfW; _hh[id] = halfH;
+		link(id, bucketOf(id));
+		_count++;
+		return id;
+	}
+	int insert(const Vec2f& pos, const Vec2f& halfSize) {
+		return insert(pos.x, pos.y, halfSize.x, halfSize.y);
+	}
+
+	/*moves the box, only relinks it when its center changes bucket*/
+	void move(int id, float x, float y) {
+		if (!valid(id)) return;
+		_x[id] = x; _y[id] = y;
+		int bucket = bucketOf(id);
+		if (bucket != _bucket[id]) {
+			unlink(id);
+			link(id, bucket);
+		}
+	}
+	void move(int id, const Vec2f& pos) {
+		move(id, pos.x, pos.y);
+	}
+
+	void resize(int id, float halfW, float halfH) {
+		if (!valid(id)) return;
+		_hw[id] = halfW; _hh[id] = halfH;
+		int bucket = bucketOf(id);
+		if (bucket != _bucket[id]) {
+			unlink(id);
+			link(id, bucket);
+		}
+	}
+
+	void remove(int id) {
+		if (!valid(id)) return;
+		unlink(id);
+		_bucket[id] = -1;
+		_free.push_back(id);
+		_count--;
+	}
+
+	void clear() {
+		std::fill(_heads.begin(), _heads.end(), -1);
+		_x.clear(); _y.clear(); _hw.clear(); _hh.clear();
+		_next.clear(); _prev.clear(); _bucket.clear(); _free.clear();
+		_count = 0;
+	}
+
+	/*calls fn(id) once for every box overlapping the given rectangle*/
+	template<typename F>
+	void queryAABB(float x0, float y0, float x1, float y1, F fn) {
+		/*hashed boxes reach at most one cell size past their center*/
+		int cx0 = cellOf(x0 - _cellSize), cx1 = cellOf(x1 + _cellSize);
+		int cy0 = cellOf(y0 - _cellSize), cy1 = cellOf(y1 + _cellSize);
+
+		/*a range wider than the table visits every bucket anyway*/
+		if ((int64_t)(cx1 - cx0 + 1) * (cy1 - cy0 + 1) > (int64_t)_heads.size()) {
+			for (int id = 0; id < (int)_bucket.size(); id++) {
+				if (_bucket[id] >= 0 && overlaps(id, x0, y0, x1, y1)) fn(id);
+			}
+			return;
+		}
+
+		/*different cells can share a bucket, stamps make sure each bucket is walked once*/
+		if (++_stamp == 0) {
+			std::fill(_visited.begin(), _visited.end(), 0);
+			_stamp = 1;
+		}
+		for (int cy = cy0; cy <= cy1; cy++) {
+			for (int cx = cx0; cx <= cx1; cx++) {
+				int bucket = hash(cx, cy);
+				if (_visited[bucket] == _stamp) continue;
+				_visited[bucket] = _stamp;
+				for (int id = _heads[bucket]; id >= 0; id = _next[id]) {
+					if (overlaps(id, x0, y0, x1, y1)) fn(id);
+				}
+			}
+		}
+		for (int id = _heads[_large]; id >= 0; id = _next[id]) {
+			if (overlaps(id, x0, y0, x1, y1)) fn(id);
+		}
+	}
+	void queryAABB(float x0, float y0, float x1, float y1, std::vector<int>& out) {
+		queryAABB(x0, y0, x1, y1, [&](int id) { out.push_back(id); });
+	}
+
+	/*appends every box that comes within r of the given point*/
+	void queryRadius(float x, float y, float r, std::vector<int>& out) {
+		queryAABB(x - r, y - r, x + r, y + r, [&](int id) {
+			float dx = fabsf(x - _x[id]) - _hw[id], dy = fabsf(y - _y[id]) - _hh[id];
+			if (dx < 0) dx = 0;
+			if (dy < 0) dy = 0;
+			if (dx * dx + dy * dy <= r * r) out.push_back(id);
+		});
+	}
+
+	/*appends every pair of overlapping boxes once, with the lower id first*/
+	void pairs(std::vector<std::pair<int, int>>& out) {
+		for (int a = 0; a < (int)_bucket.size(); a++) {
+			if (_bucket[a] < 0) continue;
+			queryAABB(_x[a] - _hw[a], _y[a] - _hh[a], _x[a] + _hw[a], _y[a] + _hh[a], [&](int b) {
+				if (b > a) out.push_back({ a, b });
+			});
+		}
+	}
+
+	Vec2f position(int id) { return { _x[id], _y[id] }; }
+	Vec2f halfSize(int id) { return { _hw[id], _hh[id] }; }
+
+private:
+	int cellOf(float v) { return (int)floorf(v * _invCell); }
+	int hash(int cx, int cy) { return (int)(((uint32_t)cx * 73856093u) ^ ((uint32_t)cy * 19349663u)) & _mask; }
+	int bucketOf(int id) {
+		if (_hw[id] > _cellSize || _hh[id] > _cellSize) return _large;
+		return hash(cellOf(_x[id]), cellOf(_y[id]));
+	}
+
+	bool overlaps(int id, float x0, float y0, float x1, float y1) {
+		return _x[id] + _hw[id] >= x0 && _x[id] - _hw[id] <= x1 && _y[id] + _hh[id] >= y0 && _y[id] - _hh[id] <= y1;
+	}
+
+	void link(int id, int bucket) {
+		_bucket[id] = bucket;
+		_prev[id] = -1;
+		_next[id] = _heads[bucket];
+		if (_next[id] >= 0) _prev[_next[id]] = id;
+		_heads[bucket] = id;
+	}
+	void unlink(int id) {
+		if (_prev[id] >= 0) _next[_prev[id]] = _next[id];
+		else _heads[_bucket[id]] = _next[id];
+		if (_next[id] >= 0) _prev[_next[id]] = _prev[id];
+	}
+};
+
+
+/*5x7 bitmap font for the printable ascii range, one byte per column with the top row in the lowest bit*/
+static const uint8_t font5x7[95][5] = {
+	{0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00}, {0x00,0x07,0x00,0x07,0x00}, {0x14,0x7F,0x14,0x7F,0x14},
+	{0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62}, {0x36,0x49,0x55,0x22,0x50}, {0x00,0x05,0x03,0x00,0x00},
+	{0x00,0x1C,0x22,0x41,0x00}, {0x00,0x41,0x22,0x1C,0x00}, {0x14,0x08,0x3E,0x08,0x14}, {0x08,0x08,0x3E,0x08,0x08},
+	{0x00,0x50,0x30,0x00,0x00}, {0x08,0x08,0x08,0x08,0x08}, {0x00,0x60,0x60,0x00,0x00}, {0x20,0x10,0x08,0x04,0x02},
+	{0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00}, {0x42,0x61,0x51,0x49,0x46}, {0x21,0x41,0x45,0x4B,0x31},
+	{0x18,0x14,0x12,0x7F,0x10}, {0x27,0x45,0x45,0x45,0x39}, {0x3C,0x4A,0x49,0x49,0x30}, {0x01,0x71,0x09,0x05,0x03},
+	{0x36,0x49,0x49,0x49,0x36}, {0x06,0x49,0x49,0x29,0x1E}, {0x00,0x36,0x36,0x00,0x00}, {0x00,0x56,0x36,0x00,0x00},
+	{0x08,0x14,0x22,0x41,0x00}, {0x14,0x14,0x14,0x14,0x14}, {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x51,0x09,0x06},
+	{0x32,0x49,0x79,0x41,0x3E}, {0x7E,0x11,0x11,0x11,0x7E}, {0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22},
+	{0x7F,0x41,0x41,0x22,0x1C}, {0x7F,0x49,0x49,0x49,0x41}, {0x7F,0x09,0x09,0x09,0x01}, {0x3E,0x41,0x49,0x49,0x7A},
+	{0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00}, {0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41},
+	{0x7F,0x40,0x40,0x40,0x40}, {0x7F,0x02,0x0C,0x02,0x7F}, {0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E},
+	{0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E}, {0x7F,0x09,0x19,0x29,0x46}, {0x46,0x49,0x49,0x49,0x31},
+	{0x01,0x01,0x7F,0x01,0x01}, {0x3F,0x40,0x40,0x40,0x3F}, {0x1F,0x20,0x40,0x20,0x1F}, {0x3F,0x40,0x38,0x40,0x3F},
+	{0x63,0x14,0x08,0x14,0x63}, {0x07,0x08,0x70,0x08,0x07}, {0x61,0x51,0x49,0x45,0x43}, {0x00,0x7F,0x41,0x41,0x00},
+	{0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x7F,0x00}, {0x04,0x02,0x01,0x02,0x04}, {0x40,0x40,0x40,0x40,0x40},
+	{0x00,0x01,0x02,0x04,0x00}, {0x20,0x54,0x54,0x54,0x78}, {0x7F,0x48,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x20},
+	{0x38,0x44,0x44,0x48,0x7F}, {0x38,0x54,0x54,0x54,0x18}, {0x08,0x7E,0x09,0x01,0x02}, {0x0C,0x52,0x52,0x52,0x3E},
+	{0x7F,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7D,0x40,0x00}, {0x20,0x40,0x44,0x3D,0x00}, {0x7F,0x10,0x28,0x44,0x00},
+	{0x00,0x41,0x7F,0x40,0x00}, {0x7C,0x04,0x18,0x04,0x78}, {0x7C,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38},
+	{0x7C,0x14,0x14,0x14,0x08}, {0x08,0x14,0x14,0x18,0x7C}, {0x7C,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x20},
+	{0x04,0x3F,0x44,0x40,0x20}, {0x3C,0x40,0x40,0x20,0x7C}, {0x1C,0x20,0x40,0x20,0x1C}, {0x3C,0x40,0x30,0x40,0x3C},
+	{0x44,0x28,0x10,0x28,0x44}, {0x0C,0x50,0x50,0x50,0x3C}, {0x44,0x64,0x54,0x4C,0x44}, {0x00,0x08,0x36,0x41,0x00},
+	{0x00,0x00,0x7F,0x00,0x00}, {0x00,0x41,0x36,0x08,0x00}, {0x08,0x04,0x08,0x10,0x08}
+};
+
+
+/*rgb of the 16 console colors, in attribute order*/
+static const uint32_t consolePalette[16] = {
+	0x000000, 0x000080, 0x008000, 0x008080, 0x800000, 0x800080, 0x808000, 0xC0C0C0,
+	0x808080, 0x0000FF, 0x00FF00, 0x00FFFF, 0xFF0000, 0xFF00FF, 0xFFFF00, 0xFFFFFF
+};
+
+/*4x4 bayer matrix, used to dither rgb colors before quantizing them*/
+static const uint8_t bayer4[4][4] = {
+	{ 0, 8, 2, 10 },
+	{ 12, 4, 14, 6 },
+	{ 3, 11, 1, 9 },
+	{ 15, 7, 13, 5 }
+};
+
 
 /* class encapsuling console drawing functionality */
 class ConsoleGraphics {
@@ -289,11 +2019,20 @@ class ConsoleGraphics {
 	bool _set;
 
 	short _color = 0xFF;
+	uint32_t _colorRGBKey = 0xFFFFFFFF;
+	uint32_t _colorRGB = 0;
+	bool _resolved = false;
+	bool _halfBlock = false;
+
+	JobSystem _jobs;
+	std::once_flag _jobsStarted;
 
 protected:
 	wchar_t pixChar = 0x2592;
 
 	CHAR_INFO* screenBuffer;
+	/*optional rgb render target as 0x00RRGGBB, null unless constructRGB was called*/
+	uint32_t* rgbBuffer = nullptr;
 
 	HANDLE hConsole;
 	COORD bufferSize;
@@ -307,11 +2046,23 @@ protected:
 	} Color;
 
 	ConsoleGraphics() {}
-	~ConsoleGraphics() { delete[] screenBuffer; }
+	~ConsoleGraphics() { delete[] screenBuffer; delete[] rgbBuffer; }
 
 	bool set() { return _set; }
 	int width() { return _width; }
 	int height() { return _height; }
+	short color() { return _color; }
+	bool resolved() { return _resolved; }
+	/*worker pool shared by the renderer and update, started the first time it's needed*/
+	JobSystem& jobs() {
+		std::call_once(_jobsStarted, [this] { _jobs.start(); });
+		return _jobs;
+	}
+	/*height of what is drawn to, twice the console height in half block mode*/
+	int targetHeight() { return _halfBlock ? _height * 2 : _height; }
+	bool halfBlock() { return _halfBlock; }
+	int fontWidth() { return fSizeW; }
+	int fontHeight() { return fSizeH; }
 
 public:
 	/*start and setup console so that drawing is possible*/
@@ -358,19 +2109,42 @@ public:
 		return true;
 	}
 
+	/*adds an rgb render target, drawing goes to it and resolve turns it into glyphs and attributes. in half block mode
+	the target is twice as tall as the console and every cell shows two pixels as an upper half block*/
+	bool constructRGB(bool halfBlock = false) {
+		if (!_set) return false;
+		_halfBlock = halfBlock;
+		delete[] rgbBuffer;
+		rgbBuffer = new uint32_t[_width * targetHeight()];
+		clear();
+		return true;
+	}
+
 protected:
-	/*cleans screenBuffer*/
+	/*cleans screenBuffer, and the rgb target if there is one*/
 	void clear() {
 		for (int i = 0; i < _width * _height; i++) {
 			screenBuffer[i].Char.UnicodeChar = ' ';
 			screenBuffer[i].Attributes = 0;
 		}
+		if (rgbBuffer) memset(rgbBuffer, 0, _width * targetHeight() * sizeof(uint32_t));
+		_resolved = false;
 	}
 
 	/*writes to the console whatever there is in the screenBuffer*/
 	bool write() {
 		if (_set) {
 			WriteConsoleOutput(hConsole, screenBuffer, bufferSize, { 0,0 }, &windowRect);
+			_resolved = false;
+			return true;
+		}
+		return false;
+	}
+
+	/*writes the given cells to the console instead of screenBuffer, there must be width() * height() of them*/
+	bool write(const CHAR_INFO* cells) {
+		if (_set) {
+			WriteConsoleOutput(hConsole, cells, bufferSize, { 0,0 }, &windowRect);
 			return true;
 		}
 		return false;
@@ -446,8 +2220,12 @@ protected:
 		return 1;
 	}
 
-	/*writes a pixel at the given location to the screenBuffer*/
+	/*writes a pixel at the given location to the screenBuffer, or to the rgb target if there is one*/
 	void point(int x, int y) {
+		if (rgbBuffer) {
+			if (x < _width && x >= 0 && y < targetHeight() && y >= 0) rgbBuffer[y * _width + x] = colorRGB();
+			return;
+		}
 		if (x < _width && x >= 0 && y < _height && y >= 0) {
 			screenBuffer[y * _width + x].Char.UnicodeChar = pixChar;
 			screenBuffer[y * _width + x].Attributes = _color;
@@ -457,6 +2235,55 @@ protected:
 		point(pos.x, pos.y);
 	}
 
+	/*writes an rgb pixel, only meaningful once constructRGB was called*/
+	void pointRGB(int x, int y, uint32_t rgb) {
+		if (rgbBuffer && x < _width && x >= 0 && y < targetHeight() && y >= 0) {
+			rgbBuffer[y * _width + x] = rgb;
+		}
+	}
+
+	/*rgb that the current color and pixChar look like, cached as long as neither changes*/
+	uint32_t colorRGB() {
+		uint32_t key = (uint32_t)(uint16_t)_color << 16 | (uint16_t)pixChar;
+		if (key != _colorRGBKey) {
+			float c = pixChar == 0x2591 ? 0.25f : pixChar == 0x2592 ? 0.5f : pixChar == 0x2593 ? 0.75f : pixChar == ' ' ? 0.f : 1.f;
+			uint32_t f = consolePalette[_color & 0x0F], b = consolePalette[_color >> 4 & 0x0F];
+			_colorRGB = 0;
+			for (int shift = 0; shift < 24; shift += 8) {
+				_colorRGB |= (uint32_t)((f >> shift & 0xFF) * c + (b >> shift & 0xFF) * (1 - c) + 0.5f) << shift;
+			}
+			_colorRGBKey = key;
+		}
+		return _colorRGB;
+	}
+
+	/*quantizes the rgb target into screenBuffer with ordered dithering, text and other direct cell drawing goes after it.
+	the engine calls it before writing if update didn't*/
+	void resolve() {
+		if (!rgbBuffer) return;
+		if (_halfBlock) {
+			resolveHalfBlock();
+			return;
+		}
+		const CellMix* lut = resolveTable();
+		const uint32_t round = 128 << 8;
+
+		jobs().parallelFor(0, _height, 32, [&](int from, int to) {
+			for (int y = from; y < to; y++) {
+				const uint32_t* src = rgbBuffer + y * _width;
+				CHAR_INFO* dst = screenBuffer + y * _width;
+				/*the dither threshold repeats every four pixels*/
+				const uint8_t* bayer = bayer4[y & 3];
+
+				for (int x = 0; x < _width; x++) {
+					const CellMix& m = lut[quantize(src[x], round)];
+					dst[x] = bayer[x & 3] < m.mix ? m.other : m.base;
+				}
+			}
+		});
+		_resolved = true;
+	}
+
 	/*writes a line that goes from and to the given points*/
 	void line(int x1, int y1, int x2, int y2) {
 		bool vert = false;
@@ -596,7 +2423,382 @@ protected:
 		fillCircle(pos.x, pos.y, r);
 	}
 
+	/*writes the string in a single clipped run starting at the given point, with the current color*/
+	void drawString(int x, int y, const wchar_t* str, int len = -1) {
+		if (len < 0) len = (int)wcslen(str);
+		if (y < 0 || y >= _height || x >= _width) return;
+		if (x < 0) {
+			str -= x; len += x; x = 0;
+		}
+		if (x + len > _width) len = _width - x;
+
+		CHAR_INFO* cell = screenBuffer + y * _width + x;
+		for (int i = 0; i < len; i++) {
+			cell[i].Char.UnicodeChar = str[i];
+			cell[i].Attributes = _color;
+		}
+	}
+	void drawString(const Vec2i& pos, const std::wstring& str) {
+		drawString(pos.x, pos.y, str.c_str(), (int)str.size());
+	}
+
+	/*formats as swprintf does into a stack buffer and writes it like drawString, lines longer than 255 characters are cut*/
+	void drawText(int x, int y, const wchar_t* format, ...) {
+		wchar_t buffer[256];
+		buffer[0] = 0;
+		va_list args;
+		va_start(args, format);
+		int len = vswprintf(buffer, 256, format, args);
+		va_end(args);
+		/*on failure or truncation the buffer is only trusted up to its terminator*/
+		buffer[255] = 0;
+		if (len < 0 || len > 255) len = (int)wcslen(buffer);
+		drawString(x, y, buffer, len);
+	}
+
+	/*writes the string with the built-in 5x7 font, every font pixel becomes a scale x scale block of pixChar*/
+	void drawBigText(int x, int y, const char* str, int scale = 1) {
+		if (scale < 1) return;
+		const GlyphRuns& glyphs = glyphRuns();
+
+		for (; *str; str++, x += 6 * scale) {
+			int c = (unsigned char)*str - 32;
+			if (c < 0 || c >= 95) continue;
+			if (x >= _width || x + 5 * scale <= 0) continue;
+
+			for (int r = glyphs.start[c]; r < glyphs.start[c + 1]; r++) {
+				const GlyphRun& run = glyphs.runs[r];
+				for (int s = 0; s < scale; s++) {
+					fillRun(x + run.x * scale, y + run.y * scale + s, run.len * scale);
+				}
+			}
+		}
+	}
+	void drawBigText(const Vec2i& pos, const std::string& str, int scale = 1) {
+		drawBigText(pos.x, pos.y, str.c_str(), scale);
+	}
+
+	/*writes every live particle with its own color in a single culling pass*/
+	void drawParticles(const ParticleSystem& particles) {
+		const float* px = particles.x.data();
+		const float* py = particles.y.data();
+		const short* pc = particles.color.data();
+		float w = (float)_width, h = (float)_height;
+
+		for (int i = 0; i < particles.size(); i++) {
+			/*tested as floats, a cast would round (-1, 0) onto the first row or column*/
+			if (!(px[i] >= 0 && px[i] < w && py[i] >= 0 && py[i] < h)) continue;
+			int x = (int)px[i], y = (int)py[i];
+			CHAR_INFO& cell = screenBuffer[y * _width + x];
+			cell.Char.UnicodeChar = pixChar;
+			cell.Attributes = pc[i];
+		}
+	}
+
+	/*draws the tile map into the view rectangle with its top-left tile at scrollX, scrollY. scrolling shifts what was
+	drawn last time and only fetches the exposed strips and the chunks edited since*/
+	void drawTileMap(TileMap& map, TileMapView& view, int scrollX, int scrollY) {
+		if (view.w <= 0 || view.h <= 0) return;
+		int dx = scrollX - view.scrollX, dy = scrollY - view.scrollY;
+		bool full = false;
+
+		if (!view.valid || (int)view.cells.size() != view.w * view.h || view.tilesetVersion != map.tilesetVersion() ||
+			abs(dx) >= view.w || abs(dy) >= view.h) {
+			view.cells.resize(view.w * view.h);
+			view.versions.assign(map.chunksX() * map.chunksY(), 0);
+			view.tilesetVersion = map.tilesetVersion();
+			view.scrollX = scrollX; view.scrollY = scrollY;
+			tileRegion(map, view, 0, 0, view.w, view.h);
+			view.valid = true;
+			full = true;
+		}
+		else if (dx != 0 || dy != 0) {
+			/*rows move by dy and every row by dx, whatever was scrolled in is fetched from the chunks*/
+			CHAR_INFO* cells = view.cells.data();
+			int rows = view.h - abs(dy), cols = view.w - abs(dx);
+			if (dy > 0) memmove(cells, cells + dy * view.w, rows * view.w * sizeof(CHAR_INFO));
+			else if (dy < 0) memmove(cells - dy * view.w, cells, rows * view.w * sizeof(CHAR_INFO));
+			if (dx != 0) {
+				for (int r = 0; r < view.h; r++) {
+					CHAR_INFO* row = cells + r * view.w;
+					if (dx > 0) memmove(row, row + dx, cols * sizeof(CHAR_INFO));
+					else memmove(row - dx, row, cols * sizeof(CHAR_INFO));
+				}
+			}
+
+			view.scrollX = scrollX; view.scrollY = scrollY;
+			if (dy > 0) tileRegion(map, view, 0, rows, view.w, dy);
+			else if (dy < 0) tileRegion(map, view, 0, 0, view.w, -dy);
+			if (dx > 0) tileRegion(map, view, cols, 0, dx, view.h);
+			else if (dx < 0) tileRegion(map, view, 0, 0, -dx, view.h);
+		}
+
+		/*chunks edited since the last draw*/
+		int c0x = floorDiv(scrollX, TileMap::CHUNK), c1x = floorDiv(scrollX + view.w - 1, TileMap::CHUNK);
+		int c0y = floorDiv(scrollY, TileMap::CHUNK), c1y = floorDiv(scrollY + view.h - 1, TileMap::CHUNK);
+		if (c0x < 0) c0x = 0;
+		if (c0y < 0) c0y = 0;
+		if (c1x >= map.chunksX()) c1x = map.chunksX() - 1;
+		if (c1y >= map.chunksY()) c1y = map.chunksY() - 1;
+		for (int cy = c0y; cy <= c1y; cy++) {
+			for (int cx = c0x; cx <= c1x; cx++) {
+				uint32_t& seen = view.versions[cy * map.chunksX() + cx];
+				uint32_t version = map.chunkVersion(cx, cy);
+				if (seen == version) continue;
+				seen = version;
+				if (full) continue;
+
+				int x0 = cx * TileMap::CHUNK - scrollX, y0 = cy * TileMap::CHUNK - scrollY;
+				int x1 = x0 + TileMap::CHUNK, y1 = y0 + TileMap::CHUNK;
+				if (x0 < 0) x0 = 0;
+				if (y0 < 0) y0 = 0;
+				if (x1 > view.w) x1 = view.w;
+				if (y1 > view.h) y1 = view.h;
+				tileRegion(map, view, x0, y0, x1 - x0, y1 - y0);
+			}
+		}
+
+		/*row copies into the screen, clipped*/
+		int sx0 = view.x < 0 ? 0 : view.x, sx1 = view.x + view.w > _width ? _width : view.x + view.w;
+		int sy0 = view.y < 0 ? 0 : view.y, sy1 = view.y + view.h > _height ? _height : view.y + view.h;
+		if (sx1 <= sx0) return;
+		for (int sy = sy0; sy < sy1; sy++) {
+			memcpy(screenBuffer + sy * _width + sx0, view.cells.data() + (sy - view.y) * view.w + (sx0 - view.x), (sx1 - sx0) * sizeof(CHAR_INFO));
+		}
+	}
+
 private:
+	/*packs every two rows of the target into one row of upper half blocks, top pixel as foreground and bottom as background.
+	every pixel is dithered between the pair of console colors that mixes closest to it*/
+	void resolveHalfBlock() {
+		const PaletteMix* lut = paletteTable();
+		const uint32_t round = 128 << 8;
+
+		jobs().parallelFor(0, _height, 32, [&](int from, int to) {
+			for (int y = from; y < to; y++) {
+				CHAR_INFO* dst = screenBuffer + y * _width;
+				const uint32_t* top = rgbBuffer + 2 * y * _width;
+				const uint32_t* bottom = top + _width;
+				const uint8_t* topBayer = bayer4[(2 * y) & 3];
+				const uint8_t* bottomBayer = bayer4[(2 * y + 1) & 3];
+
+				for (int x = 0; x < _width; x++) {
+					const PaletteMix& t = lut[quantize(top[x], round)];
+					const PaletteMix& b = lut[quantize(bottom[x], round)];
+					uint8_t fg = topBayer[x & 3] < t.mix ? t.other : t.base;
+					uint8_t bg = bottomBayer[x & 3] < b.mix ? b.other : b.base;
+					dst[x].Char.UnicodeChar = 0x2580;
+					dst[x].Attributes = fg | bg << 4;
+				}
+			}
+		});
+		_resolved = true;
+	}
+
+	/*4 bit per channel index of the given color, channels go from 0-255 to 0-15 as c * 15 / 255 plus the dither threshold*/
+	static uint32_t quantize(uint32_t c, uint32_t bias) {
+		uint32_t r = ((c >> 16 & 0xFF) * 3855 + bias) >> 16;
+		uint32_t g = ((c >> 8 & 0xFF) * 3855 + bias) >> 16;
+		uint32_t b = ((c & 0xFF) * 3855 + bias) >> 16;
+		return r << 8 | g << 4 | b;
+	}
+
+	/*a color as the nearest console color, base, mixed with mix / 16 of a second one*/
+	struct PaletteMix { uint8_t base, other, mix; };
+
+	/*best mix of two console colors for every color with 4 bits per channel, built the first time it's needed*/
+	static const PaletteMix* paletteTable() {
+		static std::vector<PaletteMix> table = [] {
+			auto channel = [](int p, int k) { return (float)(consolePalette[p] >> (16 - 8 * k) & 0xFF); };
+			const float weight[3] = { 3, 4, 2 };
+			std::vector<PaletteMix> t(4096);
+			for (int i = 0; i < 4096; i++) {
+				float c[3] = { (i >> 8) * 17.f, (i >> 4 & 15) * 17.f, (i & 15) * 17.f };
+
+				int base = 0;
+				float best = FLT_MAX;
+				for (int p = 0; p < 16; p++) {
+					float dist = 0;
+					for (int k = 0; k < 3; k++) dist += weight[k] * (channel(p, k) - c[k]) * (channel(p, k) - c[k]);
+					if (dist < best) { best = dist; base = p; }
+				}
+
+				/*the second color is the one whose segment from the nearest passes closest to the color*/
+				t[i] = { (uint8_t)base, (uint8_t)base, 0 };
+				for (int p = 0; p < 16; p++) {
+					float d[3], e[3], dd = 0, de = 0;
+					for (int k = 0; k < 3; k++) {
+						d[k] = channel(p, k) - channel(base, k);
+						e[k] = c[k] - channel(base, k);
+						dd += weight[k] * d[k] * d[k];
+						de += weight[k] * d[k] * e[k];
+					}
+					if (dd == 0 || de <= 0) continue;
+					int mix = (int)(de / dd * 16.f + 0.5f);
+					if (mix > 16) mix = 16;
+					if (mix == 0) continue;
+
+					float dist = 0;
+					for (int k = 0; k < 3; k++) dist += weight[k] * (e[k] - d[k] * mix / 16.f) * (e[k] - d[k] * mix / 16.f);
+					if (dist < best) { best = dist; t[i] = { (uint8_t)base, (uint8_t)p, (uint8_t)mix }; }
+				}
+			}
+			return t;
+		}();
+		return table.data();
+	}
+
+	/*a color as the nearest glyph and attribute pair, base, mixed with mix / 16 of a second one*/
+	struct CellMix { CHAR_INFO base, other; uint8_t mix; };
+
+	/*best mix of two glyph and attribute pairs for every color with 4 bits per channel, built the first time it's needed*/
+	static const CellMix* resolveTable() {
+		static std::vector<CellMix> table = [] {
+			const wchar_t glyphs[3] = { 0x2591, 0x2592, 0x2593 };
+			const float coverage[3] = { 0.25f, 0.5f, 0.75f };
+
+			/*every solid color and every shade glyph over every pair of colors*/
+			struct Candidate { float r, g, b; CHAR_INFO cell; };
+			std::vector<Candidate> candidates;
+			auto channel = [](uint32_t c, int shift) { return (float)(c >> shift & 0xFF); };
+			for (int fg = 0; fg < 16; fg++) {
+				uint32_t f = consolePalette[fg];
+				CHAR_INFO cell;
+				cell.Char.UnicodeChar = 0x2588;
+				cell.Attributes = (WORD)(fg | fg << 4);
+				candidates.push_back({ channel(f, 16), channel(f, 8), channel(f, 0), cell });
+
+				for (int bg = 0; bg < 16; bg++) {
+					if (bg == fg) continue;
+					uint32_t b = consolePalette[bg];
+					for (int g = 0; g < 3; g++) {
+						float c = coverage[g];
+						cell.Char.UnicodeChar = glyphs[g];
+						cell.Attributes = (WORD)(fg | bg << 4);
+						candidates.push_back({
+							channel(f, 16) * c + channel(b, 16) * (1 - c),
+							channel(f, 8) * c + channel(b, 8) * (1 - c),
+							channel(f, 0) * c + channel(b, 0) * (1 - c), cell });
+					}
+				}
+			}
+
+			std::vector<CellMix> t(4096);
+			for (int i = 0; i < 4096; i++) {
+				float r = (i >> 8) * 17.f, g = (i >> 4 & 15) * 17.f, b = (i & 15) * 17.f;
+				float best = FLT_MAX;
+				const Candidate* base = &candidates[0];
+				for (auto& c : candidates) {
+					float dr = c.r - r, dg = c.g - g, db = c.b - b;
+					float dist = 3 * dr * dr + 4 * dg * dg + 2 * db * db;
+					if (dist < best) {
+						best = dist;
+						base = &c;
+					}
+				}
+
+				/*the second cell is the one whose segment from the nearest passes closest to the color*/
+				t[i] = { base->cell, base->cell, 0 };
+				float er = r - base->r, eg = g - base->g, eb = b - base->b;
+				for (auto& c : candidates) {
+					float dr = c.r - base->r, dg = c.g - base->g, db = c.b - base->b;
+					float dd = 3 * dr * dr + 4 * dg * dg + 2 * db * db;
+					float de = 3 * dr * er + 4 * dg * eg + 2 * db * eb;
+					if (dd == 0 || de <= 0) continue;
+					int mix = (int)(de / dd * 16.f + 0.5f);
+					if (mix > 16) mix = 16;
+					if (mix == 0) continue;
+
+					float m = mix / 16.f;
+					float xr = er - dr * m, xg = eg - dg * m, xb = eb - db * m;
+					float dist = 3 * xr * xr + 4 * xg * xg + 2 * xb * xb;
+					if (dist < best) {
+						best = dist;
+						t[i] = { base->cell, c.cell, (uint8_t)mix };
+					}
+				}
+			}
+			return t;
+		}();
+		return table.data();
+	}
+
+	/*fills the given rectangle of the view cells, in view coordinates, from the chunk images*/
+	void tileRegion(TileMap& map, TileMapView& view, int x, int y, int w, int h) {
+		const int CHUNK = TileMap::CHUNK;
+		CHAR_INFO empty;
+		empty.Char.UnicodeChar = ' ';
+		empty.Attributes = 0;
+
+		for (int r = y; r < y + h; r++) {
+			CHAR_INFO* dst = view.cells.data() + r * view.w;
+			int ty = view.scrollY + r;
+			int c = x;
+			while (c < x + w) {
+				int tx = view.scrollX + c;
+				int cx = floorDiv(tx, CHUNK), cy = floorDiv(ty, CHUNK);
+				/*cells until the end of this chunk row or the region, whichever comes first*/
+				int span = CHUNK - (tx - cx * CHUNK);
+				if (span > x + w - c) span = x + w - c;
+
+				if (cx < 0 || cy < 0 || cx >= map.chunksX() || cy >= map.chunksY()) {
+					for (int i = 0; i < span; i++) dst[c + i] = empty;
+				}
+				else {
+					const CHAR_INFO* src = map.chunkImage(cx, cy) + (ty - cy * CHUNK) * CHUNK + (tx - cx * CHUNK);
+					memcpy(dst + c, src, span * sizeof(CHAR_INFO));
+				}
+				c += span;
+			}
+		}
+	}
+
+	static int floorDiv(int a, int b) {
+		return a >= 0 ? a / b : -((-a + b - 1) / b);
+	}
+
+	/*horizontal run of set pixels in a row of a font glyph*/
+	struct GlyphRun { uint8_t x, y, len; };
+	struct GlyphRuns {
+		std::vector<GlyphRun> runs;
+		int start[96];
+	};
+
+	/*the runs of every glyph of font5x7, built the first time they are needed*/
+	static const GlyphRuns& glyphRuns() {
+		static GlyphRuns glyphs = [] {
+			GlyphRuns g;
+			for (int c = 0; c < 95; c++) {
+				g.start[c] = (int)g.runs.size();
+				for (uint8_t y = 0; y < 7; y++) {
+					for (uint8_t x = 0; x < 5; x++) {
+						if (!(font5x7[c][x] & (1 << y))) continue;
+						uint8_t len = 1;
+						while (x + len < 5 && (font5x7[c][x + len] & (1 << y))) len++;
+						g.runs.push_back({ x, y, len });
+						x += len;
+					}
+				}
+			}
+			g.start[95] = (int)g.runs.size();
+			return g;
+		}();
+		return glyphs;
+	}
+
+	/*writes len cells of pixChar with the current color from the given point to the right, clipped*/
+	void fillRun(int x, int y, int len) {
+		if (y < 0 || y >= _height) return;
+		if (x < 0) { len += x; x = 0; }
+		if (x + len > _width) len = _width - x;
+
+		CHAR_INFO* cell = screenBuffer + y * _width + x;
+		for (int i = 0; i < len; i++) {
+			cell[i].Char.UnicodeChar = pixChar;
+			cell[i].Attributes = _color;
+		}
+	}
+
 	/*writes points radially simmetrycally in each octant of a circle*/
 	void octant(int xc, int yc, int x, int y) {
 		point(xc + x, yc + y);
@@ -614,139 +2816,289 @@ private:
 
 //still incomplete, use at own discrecion
 class Console3DGraphics : public ConsoleGraphics {
-	float* _zBuffer;
-	float fovTan;
+	float* _zBuffer = nullptr;
+	uint16_t* _zBuffer16 = nullptr;
 	bool _set_3D = false;
 
-	Vec4f camera = { 0,0,0 };
+	uint8_t _depthFormat = 0;
+	float _zNear, _zFar;
+
+	Viewport _screen;
+	std::vector<Viewport> _viewports;
 
-	Mat4f xRot;
-	Mat4f zRot;
-	Mat4f yRot;
-	Mat4f rotMat;
+	short _shade[12];
 
 protected:
 	typedef enum : uint8_t { NO_ROT, X_ROT, Y_ROT, Z_ROT } rot;
 
 public:
-	/*start and setup 3D environment so that 3D rendering is possible*/
-	bool construct3D(float fov) {
+	/*DEPTH_F32 keeps view space z, DEPTH_U16 keeps z mapped from [zNear, zFar] to 16 bits and DEPTH_REVERSED keeps zNear / z*/
+	typedef enum : uint8_t { DEPTH_F32, DEPTH_U16, DEPTH_REVERSED } depthFormat;
+
+	/*start and setup 3D environment so that 3D rendering is possible, zNear and zFar only matter for the compact depth formats.
+	call constructRGB before this one if the rgb target is wanted*/
+	bool construct3D(float fov, depthFormat format = DEPTH_F32, float zNear = 0.1f, float zFar = 1000.f) {
 		if (!set()) return 0;
-		if (fov >= F_PI || fov == 0) return 0;
+		if (fov >= F_PI || fov <= 0) return 0;
+		if (format != DEPTH_F32 && (zNear <= 0 || zFar <= zNear)) return 0;
+
+		_screen = Viewport(0, 0, width(), targetHeight(), fov);
 
-		fovTan = 1.f / tanf(fov / 2.f);
-		xRot.identity();
-		yRot.identity();
-		zRot.identity();
+		/*shades are precomputed so the rasterizer never touches the shared draw color*/
+		for (int i = 0; i < 12; i++) {
+			greyScale(i);
+			_shade[i] = color();
+		}
 
-		_zBuffer = new float[width() * height()];
+		_depthFormat = format;
+		_zNear = zNear;
+		_zFar = zFar;
+		if (format == DEPTH_U16) _zBuffer16 = new uint16_t[width() * targetHeight()];
+		else _zBuffer = new float[width() * targetHeight()];
 		clear3D();
 		_set_3D = true;
 		return 1;
 	}
 
+	/*the depth buffer and viewports are sized for the target, so it can't change once construct3D ran*/
+	bool constructRGB(bool halfBlock = false) {
+		if (_set_3D) return 0;
+		return ConsoleGraphics::constructRGB(halfBlock);
+	}
+
 protected:
 	Console3DGraphics() {}
-	~Console3DGraphics() { delete[] _zBuffer; }
+	~Console3DGraphics() { delete[] _zBuffer; delete[] _zBuffer16; }
 
 	bool set_3D() { return _set_3D; }
 
 	/*clears the ZBuffer*/
 	void clear3D() {
-		for (int i = 0; i < width() * height(); i++) {
-			_zBuffer[i] = FLT_MAX;
-		}
+		int size = width() * targetHeight();
+		if (_depthFormat == DEPTH_U16) memset(_zBuffer16, 0xFF, size * sizeof(uint16_t));
+		else if (_depthFormat == DEPTH_REVERSED) memset(_zBuffer, 0, size * sizeof(float));
+		else std::fill(_zBuffer, _zBuffer + size, FLT_MAX);
 	}
 
-	/*writes a filled triangle in 3D space*/
-	void fillTriangle(Vec4f& p1, Vec4f& p2, Vec4f& p3) {
-		float z;
-
-		Vec3f xComp(p1.x, p2.x, p3.x);
-		Vec3f yComp(p1.y, p2.y, p3.y);
+	/*adds a viewport covering the given screen rectangle, returns its index or -1 if it doesn't fit*/
+	int addViewport(int x, int y, int w, int h, float fov) {
+		if (x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > width() || y + h > targetHeight()) return -1;
+		if (fov >= F_PI || fov <= 0) return -1;
 
-		Vec2i bbmin(xComp.vecMin(), yComp.vecMin());
-		Vec2i bbmax(xComp.vecMax(), yComp.vecMax());
+		for (auto& v : _viewports) {
+			if (x < v.x + v.w && v.x < x + w && y < v.y + v.h && v.y < y + h) return -1;
+		}
 
-		Vec3f a(xComp.y - xComp.x, xComp.z - xComp.x, 0);
-		Vec3f b(yComp.y - yComp.x, yComp.z - yComp.x, 0);
+		_viewports.push_back(Viewport(x, y, w, h, fov));
+		return (int)_viewports.size() - 1;
+	}
 
-		Vec3f barycentric;
+	/*drawing is always clipped to the screen, but a rectangle moved onto another viewport makes renderViewports draw
+	them one after another*/
+	Viewport& viewport(int i) { return _viewports[i]; }
+	int viewportCount() { return (int)_viewports.size(); }
 
-		for (int x = bbmin.x; x <= bbmax.x; x++) {
-			for (int y = bbmin.y; y <= bbmax.y; y++) {
-				a.z = xComp.x - x;
-				b.z = yComp.x - y;
-				Vec3f u = Vec3f::cross(a, b);
+	/*removes a viewport, the ones after it move down one index*/
+	void removeViewport(int i) {
+		if (i < 0 || i >= (int)_viewports.size()) return;
+		_viewports.erase(_viewports.begin() + i);
+	}
+	void clearViewports() {
+		_viewports.clear();
+	}
 
-				barycentric = { 1.f - (u.x + u.y) / u.z, u.y / u.z, u.x / u.z };
+	/*calls draw for every viewport as a job of its own and waits for all of them, draw may only touch its own viewport*/
+	void renderViewports(const std::function<void(Viewport&)>& draw) {
+		if (_viewports.empty()) return;
 
-				if (barycentric.x >= 0 && barycentric.y >= 0 && barycentric.z >= 0) {
-					z = 0;
-					z += p1.z * barycentric.x;
-					z += p3.z * barycentric.y;
-					z += p2.z * barycentric.z;
+		if (!viewportsDisjoint()) {
+			for (auto& v : _viewports) draw(v);
+			return;
+		}
+		jobs().parallelFor(0, (int)_viewports.size(), 1, [&](int from, int to) {
+			for (int i = from; i < to; i++) draw(_viewports[i]);
+		});
+	}
 
-					if(zBuffer(x, y) > z){
-						zBuffer(x, y, z);
-						point(x, y);
-					}
-				}
-			}
+	/*writes a filled triangle in 3D space, clipped to the given viewport*/
+	void fillTriangle(const Viewport& view, Vec4f& p1, Vec4f& p2, Vec4f& p3, short color, uint32_t rgb) {
+		if (_depthFormat == DEPTH_U16) {
+			float s = 65535.f / (_zFar - _zNear);
+			rasterize<uint16_t, false>(view, p1, p2, p3, (p1.z - _zNear) * s, (p2.z - _zNear) * s, (p3.z - _zNear) * s, color, rgb, _zBuffer16);
+		}
+		else if (_depthFormat == DEPTH_REVERSED) {
+			rasterize<float, true>(view, p1, p2, p3, reversed(p1.z), reversed(p2.z), reversed(p3.z), color, rgb, _zBuffer);
 		}
+		else {
+			rasterize<float, false>(view, p1, p2, p3, p1.z, p2.z, p3.z, color, rgb, _zBuffer);
+		}
+	}
+	void fillTriangle(Vec4f& p1, Vec4f& p2, Vec4f& p3) {
+		fillTriangle(_screen, p1, p2, p3, color(), colorRGB());
 	}
 
 	/*renders the given mesh, no textures and simple shading*/
 	void renderMesh(Mesh& mesh, rot rot1 = NO_ROT, rot rot2 = NO_ROT, rot rot3 = NO_ROT) {
-		rotMat.identity();
+		renderMesh(_screen, mesh, rot1, rot2, rot3);
+	}
 
-		if (rot1 != NO_ROT || rot2 != NO_ROT || rot3 != NO_ROT) {
-			create_RotXMat(mesh.rotation.x, xRot);
-			create_RotYMat(mesh.rotation.y, yRot);
-			create_RotZMat(mesh.rotation.z, zRot);
-			rotMult(rot1);
-			rotMult(rot2);
-			rotMult(rot3);
+	/*renders the given mesh into the given viewport, safe to call concurrently for different viewports*/
+	void renderMesh(const Viewport& view, Mesh& mesh, rot rot1 = NO_ROT, rot rot2 = NO_ROT, rot rot3 = NO_ROT) {
+		Mat4f rotMat;
+		modelRotation(mesh, rotMat, rot1, rot2, rot3);
+
+		/*the camera looks down +z, its yaw and pitch are undone on every vertex*/
+		Mat4f viewYaw, viewPitch;
+		create_RotYMat(-view.rotation.y, viewYaw);
+		create_RotXMat(-view.rotation.x, viewPitch);
+		Mat4f viewMat = viewYaw * viewPitch;
+
+		/*back faces are rejected in model space, so only the camera is transformed for them*/
+		Mat4f toModel;
+		modelInverse(mesh, toModel, rot1, rot2, rot3);
+		Vec4f camera = view.camera;
+		camera = ((camera - mesh.pos) / mesh.scale) * toModel;
+
+		/*stale cones aren't rebuilt here, the triangles are tested one by one instead*/
+		const std::vector<Tri>& tris = static_cast<const Mesh&>(mesh).tris();
+		const std::vector<NormalCone>& cones = mesh.cones();
+		bool useCones = mesh.conesValid();
+		size_t groups = useCones ? cones.size() : 1;
+		size_t groupSize = useCones ? NormalCone::SIZE : tris.size();
+		for (size_t c = 0; c < groups; c++) {
+			if (useCones && cones[c].backFacing(camera)) continue;
+
+			size_t end = (c + 1) * groupSize;
+			if (end > tris.size()) end = tris.size();
+			for (size_t t = c * groupSize; t < end; t++) {
+				const Tri& model = tris[t];
+				Vec4f camToTri = model.vert[0];
+				camToTri -= camera;
+				float facing = Vec4f::dotProd(model.faceNormal(), camToTri);
+				if (facing <= 0) continue;
+
+				float dProd = facing / sqrtf(Vec4f::dotProd(camToTri, camToTri));
+
+				Tri tri = model;
+				for (int i = 0; i < 3; i++) {
+					tri.vert[i] = tri.vert[i] * rotMat;
+				}
+				triScale(tri, mesh.scale);
+				triTranslate(tri, mesh.pos);
+
+				for (int i = 0; i < 3; i++) {
+					tri.vert[i] = (tri.vert[i] - view.camera) * viewMat;
+				}
+				triProj(tri, view.fovTan);
+
+				float a = (float)view.w / 2.f;
+				for (int i = 0; i < 3; i++) {
+					tri.vert[i].x *= a; tri.vert[i].y *= a;
+					tri.vert[i].x += view.x + view.w / 2.f; tri.vert[i].y += view.y + view.h / 2.f;
+				}
+
+				shadedTriangle(view, tri.vert[0], tri.vert[1], tri.vert[2], dProd, mesh.color);
+			}
 		}
+	}
 
-		for (auto tri : mesh.tris()) {
+	/*bakes the mesh as renderMesh would place it with the same rotations into the batch, call build on it afterwards*/
+	void addToBatch(StaticBatch& batch, Mesh& mesh, rot rot1 = NO_ROT, rot rot2 = NO_ROT, rot rot3 = NO_ROT) {
+		Mat4f rotMat;
+		modelRotation(mesh, rotMat, rot1, rot2, rot3);
+
+		for (auto tri : static_cast<const Mesh&>(mesh).tris()) {
 			triRotate(tri, rotMat);
 			triScale(tri, mesh.scale);
 			triTranslate(tri, mesh.pos);
+			batch.pending.push_back(tri);
+			batch.pendingColors.push_back(mesh.color);
+		}
+	}
 
-			Vec4f camToTri = tri.vert[0] - camera;
-			camToTri.toUnit();
-			float dProd = Vec4f::dotProd(tri.normal(), camToTri);
-			if(dProd > 0){
-				triProj(tri);
+	/*renders a built batch, chunks outside the view are skipped and every vertex of the rest is projected once*/
+	void renderBatch(const Viewport& view, StaticBatch& batch) {
+		Mat4f viewYaw, viewPitch;
+		create_RotYMat(-view.rotation.y, viewYaw);
+		create_RotXMat(-view.rotation.x, viewPitch);
+		Mat4f viewMat = viewYaw * viewPitch;
 
-				float a = (float)width() / 2.f;
-				for (int i = 0; i < 3; i++) {
-					tri.vert[i].x *= a; tri.vert[i].y *= a;
-					tri.vert[i].x += width() / 2.f; tri.vert[i].y += height() / 2.f;
-				}
-				
-				greyScale(dProd * 12);
-				fillTriangle(tri.vert[0], tri.vert[1], tri.vert[2]);
+		std::vector<Vec4f> projected(batch.maxChunkVerts);
+		for (auto& chunk : batch.chunks) {
+			if (outsideView(view, viewMat, chunk.bmin, chunk.bmax)) continue;
+
+			for (int i = 0; i < chunk.vertCount; i++) {
+				projected[i] = projectVert(view, viewMat, batch.verts[chunk.firstVert + i]);
+			}
+
+			for (int t = chunk.firstTri; t < chunk.firstTri + chunk.triCount; t++) {
+				const uint32_t* index = &batch.indices[t * 3];
+				Vec4f camToTri = batch.verts[chunk.firstVert + index[0]];
+				camToTri -= view.camera;
+				float facing = Vec4f::dotProd(batch.normals[t], camToTri);
+				if (facing <= 0) continue;
+
+				float dProd = facing / sqrtf(Vec4f::dotProd(camToTri, camToTri));
+				shadedTriangle(view, projected[index[0]], projected[index[1]], projected[index[2]], dProd, batch.colors[t]);
 			}
 		}
 	}
+	void renderBatch(StaticBatch& batch) {
+		renderBatch(_screen, batch);
+	}
 
-private:
-	float zBuffer(int x, int y) {
-		if (x < width() && x >= 0 && y < height() && y >= 0) {
-			return _zBuffer[y * width() + x];
-		}
-		return 0;
+	/*casts a world space ray against the mesh placed as renderMesh places it with the same rotations*/
+	bool rayCast(Mesh& mesh, const Ray& ray, RayHit& hit, rot rot1 = NO_ROT, rot rot2 = NO_ROT, rot rot3 = NO_ROT) {
+		return rayCast(mesh, &ray, &hit, 1, rot1, rot2, rot3) == 1;
 	}
 
-	float zBuffer(int x, int y, float z) {
-		if (x < width() && x >= 0 && y < height() && y >= 0) {
-			_zBuffer[y * width() + x] = z;
+	/*casts every ray against the mesh, hits[i] answers rays[i], returns how many rays hit or -1 if its bvh is stale*/
+	int rayCast(Mesh& mesh, const Ray* rays, RayHit* hits, int count, rot rot1 = NO_ROT, rot rot2 = NO_ROT, rot rot3 = NO_ROT) {
+		for (int i = 0; i < count; i++) hits[i] = RayHit();
+		if (!mesh.bvhValid()) return -1;
+
+		Mat4f toModel;
+		modelInverse(mesh, toModel, rot1, rot2, rot3);
+		const MeshBVH& bvh = mesh.bvh();
+
+		int hitCount = 0;
+		for (int i = 0; i < count; i++) {
+			Ray local = toModelRay(mesh, toModel, rays[i]);
+			if (bvh.intersect(local, hits[i])) {
+				Vec4f origin = rays[i].origin, dir = rays[i].dir;
+				hits[i].point = origin + dir * hits[i].t;
+				hitCount++;
+			}
 		}
-		return 0;
+		return hitCount;
+	}
+
+	/*true if the segment from a to b crosses the mesh, for line of sight checks. false if its bvh is stale*/
+	bool segmentBlocked(Mesh& mesh, Vec4f a, Vec4f b, rot rot1 = NO_ROT, rot rot2 = NO_ROT, rot rot3 = NO_ROT) {
+		if (!mesh.bvhValid()) return false;
+		Mat4f toModel;
+		modelInverse(mesh, toModel, rot1, rot2, rot3);
+
+		RayHit hit;
+		return mesh.bvh().intersect(toModelRay(mesh, toModel, Ray(a, b - a, 1.f)), hit, true);
+	}
+
+	/*world space ray from the viewport camera through the given screen cell*/
+	Ray cellRay(const Viewport& view, int x, int y) {
+		float a = (float)view.w / 2.f * view.fovTan;
+		Vec4f dir((x - view.x - view.w / 2.f) / a, (y - view.y - view.h / 2.f) / a, 1.f, 0.f);
+
+		Mat4f pitch, yaw;
+		create_RotXMat(view.rotation.x, pitch);
+		create_RotYMat(view.rotation.y, yaw);
+		return Ray(view.camera, dir * (pitch * yaw));
+	}
+	/*takes console cells, in half block mode the ray goes between the cell's two pixels*/
+	Ray cellRay(int x, int y) {
+		return cellRay(_screen, x, halfBlock() ? y * 2 + 1 : y);
 	}
 
+private:
 	/*makes the given matrix into a rotation matrix for the X axis*/
 	void create_RotXMat(float theta, Mat4f& mat) {
 		mat.identity();
@@ -777,8 +3129,160 @@ private:
 		mat[2][2] = 1.0f;
 		mat[3][3] = 1.0f;
 	}
+	/*fills the triangle interpolating the given vertex depths, keeps the lesser depth or the greater one with GREATER*/
+	template<typename Depth, bool GREATER>
+	void rasterize(const Viewport& view, Vec4f& p1, Vec4f& p2, Vec4f& p3, float d1, float d2, float d3, short color, uint32_t rgb, Depth* depth) {
+		float z;
+
+		Vec3f xComp(p1.x, p2.x, p3.x);
+		Vec3f yComp(p1.y, p2.y, p3.y);
+
+		Vec2i bbmin(xComp.vecMin(), yComp.vecMin());
+		Vec2i bbmax(xComp.vecMax(), yComp.vecMax());
+		if (bbmin.x < view.x) bbmin.x = view.x;
+		if (bbmin.y < view.y) bbmin.y = view.y;
+		if (bbmax.x >= view.x + view.w) bbmax.x = view.x + view.w - 1;
+		if (bbmax.y >= view.y + view.h) bbmax.y = view.y + view.h - 1;
+		/*the viewport's rectangle is public, so it's never trusted to be on screen*/
+		if (bbmin.x < 0) bbmin.x = 0;
+		if (bbmin.y < 0) bbmin.y = 0;
+		if (bbmax.x >= width()) bbmax.x = width() - 1;
+		if (bbmax.y >= targetHeight()) bbmax.y = targetHeight() - 1;
+
+		Vec3f a(xComp.y - xComp.x, xComp.z - xComp.x, 0);
+		Vec3f b(yComp.y - yComp.x, yComp.z - yComp.x, 0);
+
+		Vec3f barycentric;
+
+		for (int y = bbmin.y; y <= bbmax.y; y++) {
+			b.z = yComp.x - y;
+			Depth* row = depth + y * width();
+			CHAR_INFO* cells = screenBuffer + y * width();
+			uint32_t* pixels = rgbBuffer ? rgbBuffer + y * width() : nullptr;
+
+			for (int x = bbmin.x; x <= bbmax.x; x++) {
+				a.z = xComp.x - x;
+				Vec3f u = Vec3f::cross(a, b);
+
+				barycentric = { 1.f - (u.x + u.y) / u.z, u.y / u.z, u.x / u.z };
+
+				if (barycentric.x >= 0 && barycentric.y >= 0 && barycentric.z >= 0) {
+					z = 0;
+					z += d1 * barycentric.x;
+					z += d3 * barycentric.y;
+					z += d2 * barycentric.z;
+
+					Depth d = toDepth(z, depth);
+					if (GREATER ? d > row[x] : d < row[x]) {
+						row[x] = d;
+						if (pixels) {
+							pixels[x] = rgb;
+							continue;
+						}
+						cells[x].Char.UnicodeChar = pixChar;
+						cells[x].Attributes = color;
+					}
+				}
+			}
+		}
+	}
+
+	static float toDepth(float z, float*) { return z; }
+	static uint16_t toDepth(float z, uint16_t*) {
+		if (z <= 0) return 0;
+		if (z >= 65534.f) return 65534;
+		return (uint16_t)z;
+	}
+	/*zNear / z, anything behind the camera is pushed to the far end*/
+	float reversed(float z) {
+		return z > 0 ? _zNear / z : 0.f;
+	}
+
+	bool viewportsDisjoint() {
+		for (size_t i = 0; i < _viewports.size(); i++) {
+			const Viewport& a = _viewports[i];
+			for (size_t j = i + 1; j < _viewports.size(); j++) {
+				const Viewport& b = _viewports[j];
+				if (a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h) return false;
+			}
+		}
+		return true;
+	}
+
+	/*fills the projected triangle shaded by how much it faces the camera*/
+	void shadedTriangle(const Viewport& view, Vec4f& p1, Vec4f& p2, Vec4f& p3, float dProd, uint32_t color) {
+		int shade = (int)(dProd * 12);
+		uint32_t rgb = 0;
+		for (int s = 0; s < 24; s += 8) rgb |= (uint32_t)((color >> s & 0xFF) * dProd) << s;
+		fillTriangle(view, p1, p2, p3, _shade[shade < 12 ? shade : 11], rgb);
+	}
+
+	/*moves a world space vertex to the viewport's screen space, the same way renderMesh does*/
+	Vec4f projectVert(const Viewport& view, Mat4f& viewMat, Vec4f v) {
+		v = (v - view.camera) * viewMat;
+		v.x *= view.fovTan;
+		v.y *= view.fovTan;
+		if (v.z > 0) {
+			v.x /= v.z;
+			v.y /= v.z;
+		}
+
+		float a = (float)view.w / 2.f;
+		v.x *= a; v.y *= a;
+		v.x += view.x + view.w / 2.f; v.y += view.y + view.h / 2.f;
+		return v;
+	}
+
+	/*true if the box is entirely behind the camera or past one side of the view frustum*/
+	bool outsideView(const Viewport& view, Mat4f& viewMat, const Vec4f& bmin, const Vec4f& bmax) {
+		/*a point is inside while |x| * fovTan <= z and |y| * fovTan * w <= z * h*/
+		int behind = 0, left = 0, right = 0, top = 0, bottom = 0;
+		for (int i = 0; i < 8; i++) {
+			Vec4f corner(i & 1 ? bmax.x : bmin.x, i & 2 ? bmax.y : bmin.y, i & 4 ? bmax.z : bmin.z);
+			Vec4f v = (corner - view.camera) * viewMat;
+			float x = v.x * view.fovTan, y = v.y * view.fovTan * view.w;
+			if (v.z <= 0) behind++;
+			if (x < -v.z) left++;
+			if (x > v.z) right++;
+			if (y < -v.z * view.h) top++;
+			if (y > v.z * view.h) bottom++;
+		}
+		return behind == 8 || left == 8 || right == 8 || top == 8 || bottom == 8;
+	}
+
+	/*makes the given matrix into the rotation renderMesh applies to the mesh*/
+	void modelRotation(Mesh& mesh, Mat4f& rotMat, rot rot1, rot rot2, rot rot3) {
+		rotMat.identity();
+
+		if (rot1 != NO_ROT || rot2 != NO_ROT || rot3 != NO_ROT) {
+			Mat4f xRot, yRot, zRot;
+			create_RotXMat(mesh.rotation.x, xRot);
+			create_RotYMat(mesh.rotation.y, yRot);
+			create_RotZMat(mesh.rotation.z, zRot);
+			rotMult(rotMat, xRot, yRot, zRot, rot1);
+			rotMult(rotMat, xRot, yRot, zRot, rot2);
+			rotMult(rotMat, xRot, yRot, zRot, rot3);
+		}
+	}
+	/*makes the given matrix into the inverse of the mesh rotation, which is its transpose*/
+	void modelInverse(Mesh& mesh, Mat4f& mat, rot rot1, rot rot2, rot rot3) {
+		Mat4f rotMat;
+		modelRotation(mesh, rotMat, rot1, rot2, rot3);
+		for (int i = 0; i < 4; i++) {
+			for (int j = 0; j < 4; j++) {
+				mat.m[i][j] = rotMat.m[j][i];
+			}
+		}
+	}
+	/*moves a world space ray into model space, t stays the same since the direction isn't normalized*/
+	Ray toModelRay(Mesh& mesh, Mat4f& toModel, const Ray& ray) {
+		Vec4f origin = ray.origin, dir = ray.dir;
+		origin = ((origin - mesh.pos) / mesh.scale) * toModel;
+		dir = (dir / mesh.scale) * toModel;
+		return Ray(origin, dir, ray.tMax);
+	}
 	/*multiplies the specified rotation matrix axis, to the full rotation matrix*/
-	void rotMult(rot arg) {
+	void rotMult(Mat4f& rotMat, Mat4f& xRot, Mat4f& yRot, Mat4f& zRot, rot arg) {
 		if (arg == X_ROT) rotMat = rotMat * xRot;
 		else if (arg == Y_ROT) rotMat = rotMat * yRot;
 		else if (arg == Z_ROT) rotMat = rotMat * zRot;
@@ -786,10 +3290,12 @@ private:
 
 	/*apllies the given rotation matrix to the vertices of the given triangle*/
 	void triRotate(Tri& tri, Mat4f& mat) {
+		/*taken before the vertices move, a normal that was never computed would otherwise be rotated twice*/
+		Vec4f normal = tri.faceNormal();
 		for (int i = 0; i < 3; i++) {
 			tri.vert[i] = tri.vert[i] * mat;
 		}
-		tri.normal() = tri.normal() * mat;
+		tri.normal() = normal * mat;
 	}
 	/*adds the given position to the vertices of the given triangle*/
 	void triTranslate(Tri& tri, Vec4f& pos) {
@@ -804,7 +3310,7 @@ private:
 		}
 	}
 	/*projects the given triangle into 2D space*/
-	void triProj(Tri& tri) {
+	void triProj(Tri& tri, float fovTan) {
 		for (int i = 0; i < 3; i++) {
 			tri.vert[i].x *= fovTan;
 			tri.vert[i].y *= fovTan;
@@ -825,6 +3331,10 @@ class ConsoleEngine: public ConsoleGraphics {
 class ConsoleEngine : public Console3DGraphics {
 #endif
 	bool keyState[254] = { 0 };
+	AssetLoader _assets;
+	FrameRecorder _recorder;
+	FramePublisher _broadcast;
+	JobGroup _frameJobs;
 protected:
 	typedef enum : uint8_t {
 		LMB = 0x01, RMB, CANCEL, MMB, X1MB, X2MB, BACK = 0x08, TAB, CLEAR = 0x0C, RETURN, SHIFT = 0x10, CTRL, ALT, PAUSE, CAPS_LOCK,
@@ -885,6 +3395,37 @@ protected:
 		return keyState[key];
 	}
 
+	/*starts loading the given obj file in the background, poll the returned handle in update*/
+	MeshHandle loadMesh(const Vec4f& pos, const Vec4f& rotation, float scale, const std::string& filePath) {
+		return _assets.loadMesh(pos, rotation, scale, filePath);
+	}
+
+	/*runs fn on the job system, the engine waits for every such job before presenting the frame*/
+	void async(std::function<void()> fn) {
+		jobs().run(_frameJobs, std::move(fn));
+	}
+
+	/*records every frame written from now on to the given file, see FrameReplayer to play it back*/
+	bool startRecording(const std::string& filePath, int keyInterval = 60) {
+		if (!set()) return 0;
+		return _recorder.open(filePath, width(), height(), keyInterval);
+	}
+	void stopRecording() {
+		_recorder.close();
+	}
+
+	/*shares every frame written from now on with viewer processes that open the same name, see FrameViewer*/
+	bool startBroadcast(const std::string& name = "Local\\ConsoleEngine", int slots = 8) {
+		if (!set()) return 0;
+		return _broadcast.open(name, width(), height(), fontWidth(), fontHeight(), slots);
+	}
+	void stopBroadcast() {
+		_broadcast.close();
+	}
+	bool broadcasting() {
+		return _broadcast.publishing();
+	}
+
 public:
 	/*starts the engine loop if the renderer is properly set*/
 	 bool start() {
@@ -901,6 +3442,7 @@ public:
 private:
 	void engineLoop() {
 		auto ts1 = std::chrono::system_clock::now();
+		auto tStart = ts1;
 		begin();
 		auto ts2 = std::chrono::system_clock::now();
 		std::chrono::duration<float> elapsedTime = ts2 -ts1;
@@ -918,8 +3460,17 @@ private:
 #endif // _3D_ENGINE
 
 			update(fElapsedTime);
+			jobs().wait(_frameJobs);
 
+			if (!resolved()) resolve();
 			write();
+
+			if (_recorder.recording()) {
+				_recorder.push(screenBuffer, std::chrono::duration<double>(ts1 - tStart).count());
+			}
+			if (_broadcast.publishing()) {
+				_broadcast.publish(screenBuffer, std::chrono::duration<double>(ts1 - tStart).count());
+			}
 		}
 	}
 };
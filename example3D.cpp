@@ -9,13 +9,20 @@ class Demo : public ConsoleEngine {
 	float theta = 0;
 
 	Mesh teapot;
-	Mesh cube;
+	MeshHandle cube;
 
 	void begin() {
-		cube = Mesh(Vec4f(0, 0, 5.f), Vec4f(F_PI / 4.f, F_PI / 4.f, 0), 1.f, "resources/cube.obj");
+		cube = loadMesh(Vec4f(0, 0, 5.f), Vec4f(F_PI / 4.f, F_PI / 4.f, 0), 1.f, "resources/cube.obj");
 	};
 	void update(float elapsedTime) {
 		clear();
+		if (!cube.ready()) return;
+
+		/*B shares the frames with viewer.exe running in other consoles*/
+		if (keyDown(B)) {
+			if (broadcasting()) stopBroadcast();
+			else startBroadcast();
+		}
 
 		if (keyPressed(LEFT)) despX = -elapsedTime * 10.f;
 		else if (keyPressed(RIGHT)) despX = elapsedTime * 10.f;
@@ -33,18 +40,19 @@ class Demo : public ConsoleEngine {
 		else if (keyPressed(D)) theta = elapsedTime * 3.f;
 		else theta = 0;
 
-		cube.rotation.y += theta;
-		cube.pos.x += despX;
-		cube.pos.y += despY;
-		cube.pos.z += despZ;
+		Mesh& mesh = cube.mesh();
+		mesh.rotation.y += theta;
+		mesh.pos.x += despX;
+		mesh.pos.y += despY;
+		mesh.pos.z += despZ;
 
-		renderMesh(cube,X_ROT, Y_ROT);
+		renderMesh(mesh,X_ROT, Y_ROT);
 	};
 };
 
 int main() {
 	Demo demo;
-	if (demo.construct(480, 270, 2, 2) && demo.construct3D(F_PI / 3.f)) {
+	if (demo.construct(480, 135, 2, 4) && demo.constructRGB(true) && demo.construct3D(F_PI / 3.f)) {
 		demo.start();
 	}
 }
@@ -0,0 +1,29 @@
+#include "ConsoleEngine.h"
+
+/*mirrors a running engine that called startBroadcast, run as many of these as needed*/
+class Viewer : public ConsoleGraphics {
+public:
+	bool present(const CHAR_INFO* cells) { return write(cells); }
+};
+
+int main(int argc, char** argv) {
+	FrameViewer frames;
+	if (!frames.open(argc > 1 ? argv[1] : "Local\\ConsoleEngine")) return 1;
+
+	Viewer viewer;
+	if (!viewer.construct(frames.width(), frames.height(), frames.fontWidth(), frames.fontHeight())) return 1;
+
+	/*frames are copied out of the mapping and only shown if the publisher didn't touch them meanwhile, presenting
+	straight from the mapping could show one the engine is overwriting*/
+	std::vector<CHAR_INFO> frame;
+	while (!frames.closed()) {
+		const CHAR_INFO* cells = frames.acquire();
+		if (!cells) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		frame.assign(cells, cells + frames.width() * frames.height());
+		if (frames.release()) viewer.present(frame.data());
+	}
+}